@@ -0,0 +1,137 @@
+#include "tftprequest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+using clock_type = std::chrono::steady_clock;
+
+static volatile long long sink; // keeps results alive
+static const char OPTIONS[] = "blksize\0" "1428\0" "tsize\0" "0\0" "timeout\0" "3\0" "windowsize\0" "16\0";
+
+/**
+ * @brief Datagram of RRQ
+ * @param filename requested file
+ * @param options NUL separated keys and values
+ * @return datagram
+ */
+static std::string datagram(const std::string & filename, const std::string & options)
+{
+	std::string result("\0\1", 2);
+
+	result.append(filename).append(1, '\0').append("octet").append(1, '\0').append(options);
+
+	return result;
+}
+
+/**
+ * @brief Parsing as done before TFTPRequest (sscanf, strlen, std::string and std::stoll per option)
+ * @param data NUL terminated copy of datagram
+ * @param length size of datagram
+ */
+static void legacy(const char * data, unsigned int length)
+{
+	char filename[512] = {0};
+	char mode[9] = {0};
+	std::string key;
+	std::string value;
+	unsigned int position;
+	long long total = 0;
+
+	sscanf(data + 2, "%511s", filename);
+	sscanf(data + 2 + strlen(filename) + 1, "%8s", mode);
+	position = 2 + strlen(filename) + 1 + strlen(mode) + 1;
+
+	while(position < length)
+	{
+		key.assign(data + position);
+		position += key.length() + 1;
+		value.assign(data + position);
+		position += value.length() + 1;
+
+		if(key == "blksize" || key == "tsize" || key == "timeout" || key == "windowsize")
+		{
+			total += std::stoll(value);
+		}
+	}
+
+	sink = total + mode[0];
+}
+
+/**
+ * @brief Parsing by TFTPRequest as done by TFTPClient
+ * @param data datagram
+ * @param length size of datagram
+ */
+static void single(const char * data, unsigned int length)
+{
+	TFTPRequest request(data, length);
+	long long total = 0;
+
+	for(unsigned int i = 0; i < request.getCount(); ++i)
+	{
+		const TFTPRequest::option & item = request.getOption(i);
+
+		if(item.key.equals("blksize") || item.key.equals("tsize") || item.key.equals("timeout") || item.key.equals("windowsize"))
+		{
+			total += TFTPRequest::number(item.value);
+		}
+	}
+
+	sink = total + request.getMode().length;
+}
+
+/**
+ * @brief Time one parser
+ * @param name label
+ * @param parse parser
+ * @param packet datagram
+ * @param rounds number of parsed datagrams
+ */
+static void measure(const char * name, void (* parse)(const char *, unsigned int), const std::string & packet, unsigned long rounds)
+{
+	std::vector<char> copy(packet.begin(), packet.end());
+	clock_type::time_point start;
+	double elapsed;
+
+	copy.push_back('\0'); // legacy parser needs terminated buffer
+
+	start = clock_type::now();
+
+	for(unsigned long i = 0; i < rounds; ++i)
+	{
+		parse(copy.data(), packet.size());
+	}
+
+	elapsed = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+	std::cout << "  " << name << ": " << (long long) (elapsed / rounds) << " ns per request" << std::endl;
+}
+
+/**
+ * @brief Compare request parsers on typical datagrams
+ * @param argc count of arguments
+ * @param argv optional number of rounds
+ * @return 0
+ */
+int main(int argc, char * argv[])
+{
+	unsigned long rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	std::string options(OPTIONS, sizeof(OPTIONS) - 1);
+	std::vector<std::pair<const char *, std::string>> packets =
+	{
+		{"plain RRQ", datagram("pxelinux.0", "")},
+		{"RRQ with 4 options", datagram("boot/x86_64/loader/linux", options)},
+		{"long filename", datagram(std::string(400, 'f'), options)}
+	};
+
+	for(const std::pair<const char *, std::string> & packet : packets)
+	{
+		std::cout << packet.first << " (" << packet.second.size() << " B)" << std::endl;
+		measure("sscanf/stoll", legacy, packet.second, rounds);
+		measure("TFTPRequest", single, packet.second, rounds);
+	}
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+#include "tftprequest.h"
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <iostream>
+
+/**
+ * @brief Is view inside datagram?
+ * @param item parsed field
+ * @param data datagram
+ * @param size size of datagram
+ * @return true if every byte of view lies in datagram and no byte is NUL
+ */
+static bool inside(const TFTPRequest::view & item, const char * data, std::size_t size)
+{
+	if(item.data < data || item.data + item.length > data + size)
+	{
+		return false;
+	}
+
+	return memchr(item.data, '\0', item.length) == nullptr;
+}
+
+/**
+ * @brief libFuzzer entry, parse datagram as server does and check fields point into it
+ * @param data datagram
+ * @param size size of datagram
+ * @return 0
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, std::size_t size)
+{
+	// separate copy so that ASan catches every read behind datagram
+	std::vector<char> datagram(data, data + size);
+	const char * buffer = datagram.data();
+
+	try
+	{
+		TFTPRequest request(buffer, size);
+
+		if(!inside(request.getFilename(), buffer, size) || request.getFilename().length == 0 || !inside(request.getMode(), buffer, size) || request.getCount() > TFTPRequest::MAX_OPTIONS)
+		{
+			abort();
+		}
+
+		request.getMode().equals("netascii");
+		request.getMode().equals("octet");
+
+		for(unsigned int i = 0; i < request.getCount(); ++i)
+		{
+			const TFTPRequest::option & item = request.getOption(i);
+
+			if(!inside(item.key, buffer, size) || !inside(item.value, buffer, size))
+			{
+				abort();
+			}
+
+			item.key.equals("blksize");
+
+			try
+			{
+				if(TFTPRequest::number(item.value) < 0)
+				{
+					abort();
+				}
+			}
+			catch(TFTPProtocolException & e)
+			{
+				if(e.getCode() != TFTPProtocolException::OPTION)
+				{
+					abort();
+				}
+			}
+		}
+	}
+	catch(TFTPProtocolException & e)
+	{
+		if(e.getCode() != TFTPProtocolException::ILLEGAL && e.getCode() != TFTPProtocolException::OPTION)
+		{
+			abort();
+		}
+	}
+
+	return 0;
+}
+
+#ifdef FUZZ_MAIN
+/**
+ * @brief Run saved inputs without libFuzzer (compilers without -fsanitize=fuzzer)
+ * @param argc count of arguments
+ * @param argv files with datagrams
+ * @return 0
+ */
+int main(int argc, char * argv[])
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		std::ifstream input(argv[i], std::ios::binary);
+		std::vector<uint8_t> datagram((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+		LLVMFuzzerTestOneInput(datagram.data(), datagram.size());
+	}
+
+	std::cout << argc - 1 << " inputs" << std::endl;
+
+	return 0;
+}
+#endif
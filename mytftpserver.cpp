@@ -8,11 +8,25 @@
 
 void printHelp()
 {
-	std::cout << "mytftpserver -d cesta [-a adresa1,port1;adresa2,port2 -t timeout -s velikost]" << std::endl;
+	std::cout << "mytftpserver -d cesta [-a adresa1,port1;adresa2,port2 -t timeout -s velikost -w vlakna -l sockety -b hash|load -u -f none|end|periodic -c cache -o soubory -p -m adresa,port -r 0|1 -n pokusy -k cíl,rychlost[,burst] -x relace[,klient[,soubor]] -q délka[,ms]]" << std::endl;
     std::cout << "\t-d pracovní adresář" << std::endl;
     std::cout << "\t-s blocksize" << std::endl;
     std::cout << "\t-t timeout" << std::endl;
     std::cout << "\t-a adresa" << std::endl;
+    std::cout << "\t-w počet obslužných vláken" << std::endl;
+    std::cout << "\t-l počet socketů na adresu (SO_REUSEPORT)" << std::endl;
+    std::cout << "\t-b výběr socketu: hash (podle adresy klienta), load (nejméně vytížený)" << std::endl;
+    std::cout << "\t-u io_uring místo epoll (je-li podporován jádrem)" << std::endl;
+    std::cout << "\t-f fsync nahraných souborů: none, end (před posledním ACK), periodic (průběžně a na konci)" << std::endl;
+    std::cout << "\t-c velikost cache souborů v MB" << std::endl;
+    std::cout << "\t-o počet sdílených otevřených souborů" << std::endl;
+    std::cout << "\t-p buffery paketů v huge pages" << std::endl;
+    std::cout << "\t-m multicast adresa a první port" << std::endl;
+    std::cout << "\t-r číslo bloku po 65535" << std::endl;
+    std::cout << "\t-n max. počet opakování paketu" << std::endl;
+    std::cout << "\t-x max. počet souběžných přenosů celkem, od jednoho klienta a jednoho souboru (prázdné = bez omezení)" << std::endl;
+    std::cout << "\t-q délka fronty čekajících RRQ a max. doba čekání v ms" << std::endl;
+    std::cout << "\t-k omezení rychlosti v B/s (přípona K, M, G), cíl: global (celý server), host (každý klient), adresa/prefix (síť); lze opakovat" << std::endl;
 }
 
 int main(int argc, char* argv[])
@@ -20,14 +34,16 @@ int main(int argc, char* argv[])
 	std::cout.sync_with_stdio();
 
 	int opt;
+	std::vector<unsigned int> limits;
 	Params params;
 	TFTPServer server;
 
 	signal(SIGINT, &TFTPServer::terminate);
+	signal(SIGUSR1, &TFTPServer::requestReport);
 
 	try
 	{
-		while((opt = getopt(argc, argv, "d:a:t:s:")) != -1)
+		while((opt = getopt(argc, argv, "d:a:t:s:w:l:b:uf:c:o:pm:r:n:k:x:q:")) != -1)
 		{
 			switch(opt)
 			{
@@ -46,6 +62,95 @@ int main(int argc, char* argv[])
 				case 't': // timeout
 					params.timeout = params.parseInt(optarg);
 					break;
+
+				case 'w': // event loop threads
+					params.workers = params.parseInt(optarg);
+					break;
+
+				case 'l': // listening sockets per address
+					params.listeners = params.parseInt(optarg);
+					break;
+
+				case 'b': // steering in SO_REUSEPORT group
+					params.steering.assign(optarg);
+
+					if(params.steering != TFTPSteering::HASH && params.steering != TFTPSteering::LOAD)
+					{
+						throw std::invalid_argument("steering");
+					}
+					break;
+
+				case 'u': // io_uring event loops
+					params.uring = true;
+					break;
+
+				case 'f': // fsync policy of uploads
+					params.sync.assign(optarg);
+
+					if(params.sync != TFTPWriter::NONE && params.sync != TFTPWriter::END && params.sync != TFTPWriter::PERIODIC)
+					{
+						throw std::invalid_argument("sync");
+					}
+					break;
+
+				case 'c': // file cache size
+					params.cache = params.parseInt(optarg);
+					break;
+
+				case 'o': // descriptor cache size
+					params.descriptors = params.parseInt(optarg);
+					break;
+
+				case 'p': // huge pages for packet buffers
+					params.hugePages = true;
+					break;
+
+				case 'm': // multicast group
+					params.multicast = params.parseAddress(std::string(optarg), Params::DEFAULT_MULTICAST_PORT);
+					break;
+
+				case 'k': // rate limit
+					params.limits.push_back(std::string(optarg));
+					break;
+
+				case 'x': // session limits
+					limits = params.parseInts(std::string(optarg));
+
+					if(limits.size() > 3)
+					{
+						throw std::invalid_argument("sessions");
+					}
+
+					limits.resize(3);
+					params.maxSessions = limits[0];
+					params.maxPerClient = limits[1];
+					params.maxPerFile = limits[2];
+					break;
+
+				case 'q': // queue of pending RRQs
+					limits = params.parseInts(std::string(optarg));
+
+					if(limits.size() > 2)
+					{
+						throw std::invalid_argument("queue");
+					}
+
+					params.queueLength = limits[0];
+					params.queueTime = limits.size() == 2 && limits[1] != 0 ? limits[1] : params.queueTime;
+					break;
+
+				case 'n': // retransmissions
+					params.retries = params.parseInt(optarg);
+					break;
+
+				case 'r': // block number rollover
+					params.rollover = std::string(optarg) == "0" ? 0 : params.parseInt(optarg);
+
+					if(params.rollover > 1)
+					{
+						throw std::invalid_argument("rollover");
+					}
+					break;
 				default:
 					printHelp();
 					return 0;
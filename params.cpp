@@ -1,6 +1,7 @@
 #include "params.h"
 
 unsigned short Params::DEFAULT_PORT = 69;
+unsigned short Params::DEFAULT_MULTICAST_PORT = 1758;
 int Params::NOT_SET = -1;
 
 /**
@@ -116,6 +117,27 @@ unsigned int Params::parseInt(const char * ptr)
 
 }
 
+/**
+ * @brief Split string by comma into numbers, empty field is 0 (not set)
+ * @param src numbers separated by comma
+ * @return numbers in order
+ */
+std::vector<unsigned int> Params::parseInts(std::string src)
+{
+	std::vector<unsigned int> result;
+	std::size_t pos;
+
+	do
+	{
+		pos = src.find(',');
+		result.push_back(pos == 0 || src.empty() ? 0 : this->parseInt(src.substr(0, pos).c_str()));
+		src = pos == std::string::npos ? std::string() : src.substr(pos + 1);
+
+	} while(pos != std::string::npos);
+
+	return result;
+}
+
 /**
  * @brief Are all required parameters set?
  * @return
@@ -128,6 +150,16 @@ bool Params::valid()
 		this->addresses.push_back(addr);
 	}
 
+	if(this->workers == Params::NOT_SET)
+	{
+		this->workers = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	if(this->listeners == Params::NOT_SET)
+	{
+		this->listeners = std::max(1u, std::thread::hardware_concurrency());
+	}
+
 	return !this->dir.empty();
 }
 
@@ -153,4 +185,43 @@ void Params::print()
 	{
 		std::cout << "Max. timeout: " << this->timeout << "s" << std::endl;
 	}
+
+	std::cout << "Max. retries: " << this->retries << std::endl;
+
+	std::cout << "Workers: " << this->workers << std::endl;
+	std::cout << "Listeners per address: " << this->listeners << std::endl;
+
+	if(!this->steering.empty())
+	{
+		std::cout << "Steering: " << this->steering << std::endl;
+	}
+	if(!this->sync.empty())
+	{
+		std::cout << "Upload sync: " << this->sync << std::endl;
+	}
+
+	std::cout << "I/O: " << (this->uring ? "io_uring" : "epoll") << std::endl;
+	std::cout << "File cache: " << this->cache << "MB" << std::endl;
+	std::cout << "Open files: " << this->descriptors << std::endl;
+
+	for(const std::string & limit : this->limits)
+	{
+		std::cout << "Rate limit: " << limit << std::endl;
+	}
+
+	if(this->maxSessions != 0 || this->maxPerClient != 0 || this->maxPerFile != 0)
+	{
+		std::cout << "Max. sessions: " << this->maxSessions << " total, " << this->maxPerClient << " per client, " << this->maxPerFile << " per file (0 = unlimited)" << std::endl;
+		std::cout << "Request queue: " << this->queueLength << " RRQs, " << this->queueTime << " ms" << std::endl;
+	}
+
+	if(this->hugePages)
+	{
+		std::cout << "Packet buffers: huge pages" << std::endl;
+	}
+
+	if(!std::get<0>(this->multicast).empty())
+	{
+		std::cout << "Multicast: " << std::get<0>(this->multicast) << ":" << std::get<1>(this->multicast) << std::endl;
+	}
 }
@@ -2,6 +2,7 @@
 #define H_PARAMS
 
 #include <vector>
+#include <algorithm>
 #include <tuple>
 #include <string>
 #include <cstring>
@@ -16,6 +17,7 @@ class Params
 {
 	public:
 		static unsigned short DEFAULT_PORT;
+		static unsigned short DEFAULT_MULTICAST_PORT;
 		static int NOT_SET; //
 
 		// adress, port, ipv6, socket, max mtu
@@ -26,10 +28,28 @@ class Params
 		std::string addr;
 		int blocksize = NOT_SET;
 		int timeout = 3;
+		int retries = 5;
+		int rollover = 0; // block number following 65535
+		int workers = NOT_SET;
+		int listeners = NOT_SET; // SO_REUSEPORT sockets per address
+		std::string steering; // choice of socket in SO_REUSEPORT group, empty = kernel hash
+		std::string sync; // fsync policy of uploads, empty = none
+		bool uring = false; // io_uring event loops, epoll if kernel lacks it
+		int cache = 128; // MB
+		int descriptors = 256; // open files shared by sessions
+		bool hugePages = false; // packet buffers in huge pages
+		std::vector<std::string> limits; // rate limits of RRQ data, global|host|address/prefix,rate[,burst]
+		unsigned int maxSessions = 0; // concurrent sessions, 0 = unlimited
+		unsigned int maxPerClient = 0;
+		unsigned int maxPerFile = 0;
+		unsigned int queueLength = 0; // RRQs waiting for free session
+		unsigned int queueTime = 1000; // ms
+		fullAddr multicast; // RFC 2090 group address and first port, empty = disabled
 
 		void parseAddresses(std::string src);
 		fullAddr parseAddress(std::string src, unsigned short defaultPort);
 		unsigned int parseInt(const char * ptr);
+		std::vector<unsigned int> parseInts(std::string src);
 		bool valid();
 		void print();
 };
@@ -0,0 +1,260 @@
+#include "tftpadmission.h"
+#include "tftpclient.h"
+
+const int TFTPAdmission::ADMITTED = 0;
+const int TFTPAdmission::QUEUED = 1;
+const int TFTPAdmission::REJECTED = 2;
+
+TFTPAdmission::TFTPAdmission() : queueTime(0), queued(0), accepted(0), delayed(0), rejected(0), timedOut(0), waited(0)
+{
+
+}
+
+/**
+ * @brief Process wide limits of concurrent sessions
+ * @return admission
+ */
+TFTPAdmission & TFTPAdmission::instance()
+{
+	static TFTPAdmission admission;
+	return admission;
+}
+
+/**
+ * @brief Set limits, called before listeners start
+ * @param sessions max concurrent sessions, 0 = unlimited
+ * @param perClient max sessions of one client address, 0 = unlimited
+ * @param perFile max sessions of one file, 0 = unlimited
+ * @param queueLength max RRQs waiting for free session, 0 = reject at once
+ * @param queueTime ms after which waiting RRQ is rejected
+ */
+void TFTPAdmission::configure(unsigned int sessions, unsigned int perClient, unsigned int perFile, std::size_t queueLength, unsigned int queueTime)
+{
+	this->maxSessions = sessions;
+	this->maxPerClient = perClient;
+	this->maxPerFile = perFile;
+	this->queueLength = queueLength;
+	this->queueTime = std::chrono::milliseconds(queueTime);
+}
+
+/**
+ * @brief Is any limit set?
+ * @return false if every request is admitted
+ */
+bool TFTPAdmission::enabled()
+{
+	return this->maxSessions != 0 || this->maxPerClient != 0 || this->maxPerFile != 0;
+}
+
+/**
+ * @brief Decide about new session, RRQ over limit waits in queue while there is room
+ * @param session new session
+ * @param addr client address
+ * @param file requested file
+ * @param read session is RRQ
+ * @return ADMITTED, QUEUED or REJECTED
+ */
+int TFTPAdmission::admit(TFTPClient * session, const sockaddr * addr, const std::string & file, bool read)
+{
+	entry keys;
+	bool ahead = false; // queued request could start now, keep order
+
+	if(addr->sa_family == AF_INET6)
+	{
+		keys.client.assign((const char *) &((const sockaddr_in6 *) addr)->sin6_addr, sizeof(in6_addr));
+	}
+	else
+	{
+		keys.client.assign((const char *) &((const sockaddr_in *) addr)->sin_addr, sizeof(in_addr));
+	}
+
+	keys.file = file;
+
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	if(this->fits(keys))
+	{
+		for(std::deque<waiting>::iterator it = this->queue.begin(); it != this->queue.end() && !ahead; ++it)
+		{
+			ahead = this->fits(it->keys);
+		}
+
+		// full queue cannot keep order, request within limits is not refused because of it
+		if(!ahead || !read || this->queue.size() >= this->queueLength)
+		{
+			this->enter(session, keys);
+			++this->accepted;
+			return ADMITTED;
+		}
+	}
+
+	if(read && this->queue.size() < this->queueLength)
+	{
+		this->queue.push_back(waiting{session, keys, clock::now()});
+		this->queued = this->queue.size();
+		++this->delayed;
+		return QUEUED;
+	}
+
+	++this->rejected;
+	return REJECTED;
+}
+
+/**
+ * @brief Session is over, free its place
+ * @param session destroyed session, ignored if it was not admitted
+ */
+void TFTPAdmission::leave(const TFTPClient * session)
+{
+	std::unordered_map<std::string, unsigned int>::iterator count;
+	std::lock_guard<std::mutex> guard(this->lock);
+	std::unordered_map<const TFTPClient *, entry>::iterator it = this->admitted.find(session);
+
+	if(it == this->admitted.end())
+	{
+		return;
+	}
+
+	--this->sessions;
+
+	count = this->clients.find(it->second.client);
+
+	if(--count->second == 0)
+	{
+		this->clients.erase(count);
+	}
+
+	count = this->files.find(it->second.file);
+
+	if(--count->second == 0)
+	{
+		this->files.erase(count);
+	}
+
+	this->admitted.erase(it);
+}
+
+/**
+ * @brief Take queued sessions which fit limits now and those which waited too long, in order of arrival
+ * @param ready admitted sessions, caller starts them
+ * @param expired sessions over queue time, caller rejects them
+ */
+void TFTPAdmission::promote(std::vector<TFTPClient *> & ready, std::vector<TFTPClient *> & expired)
+{
+	clock::time_point now;
+
+	if(this->queued == 0)
+	{
+		return;
+	}
+
+	now = clock::now();
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	for(std::deque<waiting>::iterator it = this->queue.begin(); it != this->queue.end();)
+	{
+		if(now - it->since > this->queueTime)
+		{
+			expired.push_back(it->session);
+			++this->timedOut;
+		}
+		else if(this->fits(it->keys))
+		{
+			this->enter(it->session, it->keys);
+			ready.push_back(it->session);
+			this->waited += std::chrono::duration_cast<std::chrono::milliseconds>(now - it->since).count();
+			++this->accepted;
+		}
+		else
+		{
+			++it;
+			continue;
+		}
+
+		it = this->queue.erase(it);
+	}
+
+	this->queued = this->queue.size();
+}
+
+/**
+ * @brief Are requests waiting in queue?
+ * @return true if a loop still has to promote or expire them
+ */
+bool TFTPAdmission::hasQueued()
+{
+	return this->queued != 0;
+}
+
+/**
+ * @brief Refuse and destroy sessions left in queue after loops are drained
+ */
+void TFTPAdmission::clear()
+{
+	std::deque<waiting> left;
+
+	this->lock.lock();
+	left.swap(this->queue);
+	this->queued = 0;
+	this->lock.unlock();
+
+	// destructor of session calls leave, lock must not be held
+	for(waiting & item : left)
+	{
+		item.session->reject();
+		delete item.session;
+	}
+}
+
+/**
+ * @brief Print admission statistics
+ */
+void TFTPAdmission::print()
+{
+	if(!this->enabled())
+	{
+		return;
+	}
+
+	std::cout << "Admission: " << this->accepted << " admitted, " << this->delayed << " queued (" << this->waited << " ms waited), " << this->rejected << " rejected, " << this->timedOut << " expired in queue" << std::endl;
+}
+
+/**
+ * @brief Would session be within limits, lock must be held
+ * @param keys client and file of session
+ * @return true if it can start
+ */
+bool TFTPAdmission::fits(const entry & keys)
+{
+	std::unordered_map<std::string, unsigned int>::iterator count;
+
+	if(this->maxSessions != 0 && this->sessions >= this->maxSessions)
+	{
+		return false;
+	}
+
+	if(this->maxPerClient != 0 && (count = this->clients.find(keys.client)) != this->clients.end() && count->second >= this->maxPerClient)
+	{
+		return false;
+	}
+
+	if(this->maxPerFile != 0 && (count = this->files.find(keys.file)) != this->files.end() && count->second >= this->maxPerFile)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Count admitted session, lock must be held
+ * @param session session
+ * @param keys client and file of session
+ */
+void TFTPAdmission::enter(const TFTPClient * session, const entry & keys)
+{
+	++this->sessions;
+	++this->clients[keys.client];
+	++this->files[keys.file];
+	this->admitted[session] = keys;
+}
@@ -0,0 +1,78 @@
+#ifndef H_TFTPADMISSION
+#define H_TFTPADMISSION
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+class TFTPClient;
+
+class TFTPAdmission
+{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		static const int ADMITTED; // session may start
+		static const int QUEUED; // RRQ waits in queue, session is owned by queue
+		static const int REJECTED; // caller sends error and drops session
+
+	private:
+		// keys of admitted session, client address can change (multicast master)
+		struct entry
+		{
+			std::string client;
+			std::string file;
+		};
+
+		struct waiting
+		{
+			TFTPClient * session;
+			entry keys;
+			clock::time_point since;
+		};
+
+		std::mutex lock;
+		unsigned int maxSessions = 0; // 0 = unlimited
+		unsigned int maxPerClient = 0;
+		unsigned int maxPerFile = 0;
+		std::size_t queueLength = 0;
+		std::chrono::milliseconds queueTime;
+
+		unsigned int sessions = 0;
+		std::unordered_map<std::string, unsigned int> clients;
+		std::unordered_map<std::string, unsigned int> files;
+		std::unordered_map<const TFTPClient *, entry> admitted;
+		std::deque<waiting> queue; // FIFO, head waits only for its own limits
+		std::atomic<std::size_t> queued; // length of queue without lock
+
+		std::atomic<unsigned long> accepted;
+		std::atomic<unsigned long> delayed;
+		std::atomic<unsigned long> rejected;
+		std::atomic<unsigned long> timedOut;
+		std::atomic<long long> waited; // ms spent in queue by promoted requests
+
+		TFTPAdmission();
+		bool fits(const entry & keys);
+		void enter(const TFTPClient * session, const entry & keys);
+
+	public:
+		static TFTPAdmission & instance();
+
+		void configure(unsigned int sessions, unsigned int perClient, unsigned int perFile, std::size_t queueLength, unsigned int queueTime);
+		bool enabled();
+		int admit(TFTPClient * session, const sockaddr * addr, const std::string & file, bool read);
+		void leave(const TFTPClient * session);
+		void promote(std::vector<TFTPClient *> & ready, std::vector<TFTPClient *> & expired);
+		bool hasQueued();
+		void clear();
+		void print();
+};
+
+#endif
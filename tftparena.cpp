@@ -0,0 +1,53 @@
+#include "tftparena.h"
+
+const std::size_t TFTPArena::BLOCK = 8192;
+
+/**
+ * @brief Return every block to pool, objects in arena must be destroyed already
+ */
+TFTPArena::~TFTPArena()
+{
+	header * block;
+
+	while(this->head != nullptr)
+	{
+		block = this->head;
+		this->head = block->next;
+		TFTPBufferPool::instance().release((char *) block, block->size);
+	}
+}
+
+/**
+ * @brief Bump allocation from pooled blocks of session, memory is freed only with arena
+ * @param size bytes, at most 64 KiB minus block header
+ * @return memory aligned to cache line
+ * @throws std::bad_alloc size does not fit biggest pool buffer
+ */
+void * TFTPArena::allocate(std::size_t size)
+{
+	const std::size_t line = 64;
+	std::size_t offset = (this->used + line - 1) / line * line;
+	std::size_t capacity;
+	header * block;
+
+	size = (size + line - 1) / line * line;
+
+	if(size + line > TFTPBufferPool::capacity(size + line))
+	{
+		throw std::bad_alloc();
+	}
+
+	if(this->head == nullptr || offset + size > this->head->size)
+	{
+		capacity = TFTPBufferPool::capacity(std::max(BLOCK, size + line));
+		block = (header *) TFTPBufferPool::instance().acquire(capacity);
+		block->next = this->head;
+		block->size = capacity;
+		this->head = block;
+		offset = line; // header occupies first line
+	}
+
+	this->used = offset + size;
+
+	return (char *) this->head + offset;
+}
@@ -0,0 +1,28 @@
+#ifndef H_TFTPARENA
+#define H_TFTPARENA
+
+#include "tftpbufferpool.h"
+#include <cstddef>
+
+class TFTPArena
+{
+	public:
+		static const std::size_t BLOCK; // usual size of block taken from pool
+
+	private:
+		// start of every block, blocks of one arena form a list
+		struct header
+		{
+			header * next;
+			std::size_t size;
+		};
+
+		header * head = nullptr;
+		std::size_t used = 0; // bytes of head block already handed out
+
+	public:
+		~TFTPArena();
+		void * allocate(std::size_t size);
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "tftpbufferpool.h"
+
+const std::size_t TFTPBufferPool::MIN_SIZE = 512;
+const std::size_t TFTPBufferPool::SLAB = 2 * 1024 * 1024;
+
+TFTPBufferPool::TFTPBufferPool() : slabs(0), hugeSlabs(0)
+{
+
+}
+
+/**
+ * @brief Process wide pool of packet buffers
+ * @return pool
+ */
+TFTPBufferPool & TFTPBufferPool::instance()
+{
+	static TFTPBufferPool pool;
+	return pool;
+}
+
+/**
+ * @brief Back new slabs by huge pages (MAP_HUGETLB), regular pages are used if none are reserved
+ * @param huge use huge pages
+ */
+void TFTPBufferPool::setHuge(bool huge)
+{
+	this->huge = huge;
+}
+
+/**
+ * @brief Get buffer, slabs are never returned to system so steady state does not allocate
+ * @param size required size, at most 64 KiB
+ * @return buffer aligned to cache line, capacity(size) bytes
+ */
+char * TFTPBufferPool::acquire(std::size_t size)
+{
+	sizeClass & free = this->classes[TFTPBufferPool::find(size)];
+	char * buffer;
+	std::lock_guard<std::mutex> guard(free.lock);
+
+	if(free.free.empty())
+	{
+		this->carve(free, TFTPBufferPool::capacity(size)); // lock is released if it throws
+	}
+
+	buffer = free.free.back();
+	free.free.pop_back();
+
+	return buffer;
+}
+
+/**
+ * @brief Return buffer to its class
+ * @param buffer buffer from acquire
+ * @param size size passed to acquire
+ */
+void TFTPBufferPool::release(char * buffer, std::size_t size)
+{
+	sizeClass & free = this->classes[TFTPBufferPool::find(size)];
+
+	if(buffer == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(free.lock);
+	free.free.push_back(buffer);
+}
+
+/**
+ * @brief Real size of buffer returned for required size
+ * @param size required size
+ * @return size of class
+ */
+std::size_t TFTPBufferPool::capacity(std::size_t size)
+{
+	return MIN_SIZE << TFTPBufferPool::find(size);
+}
+
+/**
+ * @brief Find slab holding buffer (for registration in io_uring)
+ * @param buffer buffer from acquire
+ * @param base start of slab, SLAB bytes
+ * @return index of slab in order of mapping or -1
+ */
+int TFTPBufferPool::slab(const char * buffer, char * & base)
+{
+	std::lock_guard<std::mutex> guard(this->slabLock);
+
+	for(std::size_t i = 0; i < this->slabList.size(); ++i)
+	{
+		if(buffer >= this->slabList[i] && buffer < this->slabList[i] + SLAB)
+		{
+			base = this->slabList[i];
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Print pool statistics
+ */
+void TFTPBufferPool::print()
+{
+	std::cout << "Packet buffers: " << this->slabs << " slabs (" << this->hugeSlabs << " huge pages)" << std::endl;
+}
+
+/**
+ * @brief Class of buffers big enough for size
+ * @param size required size
+ * @return index of class
+ */
+unsigned int TFTPBufferPool::find(std::size_t size)
+{
+	unsigned int index = 0;
+
+	while(index < CLASSES - 1 && (MIN_SIZE << index) < size)
+	{
+		++index;
+	}
+
+	return index;
+}
+
+/**
+ * @brief Split new slab into free buffers, lock of class must be held
+ * @param free class
+ * @param size size of buffers in class
+ */
+void TFTPBufferPool::carve(sizeClass & free, std::size_t size)
+{
+	void * slab = MAP_FAILED;
+
+	if(this->huge)
+	{
+		slab = mmap(NULL, SLAB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if(slab != MAP_FAILED)
+		{
+			++this->hugeSlabs;
+		}
+	}
+
+	if(slab == MAP_FAILED)
+	{
+		slab = mmap(NULL, SLAB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if(slab == MAP_FAILED)
+		{
+			throw std::bad_alloc();
+		}
+	}
+
+	++this->slabs;
+
+	this->slabLock.lock();
+	this->slabList.push_back((char *) slab);
+	this->slabLock.unlock();
+
+	for(std::size_t offset = SLAB; offset >= size; offset -= size)
+	{
+		free.free.push_back((char *) slab + offset - size);
+	}
+}
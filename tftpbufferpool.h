@@ -0,0 +1,51 @@
+#ifndef H_TFTPBUFFERPOOL
+#define H_TFTPBUFFERPOOL
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+class TFTPBufferPool
+{
+	public:
+		static const std::size_t MIN_SIZE; // smallest class, classes double up to 64 KiB
+		static const unsigned int CLASSES = 8;
+		static const std::size_t SLAB; // carved into buffers of one class, one huge page
+
+	private:
+		// free buffers of one size
+		struct sizeClass
+		{
+			std::mutex lock;
+			std::vector<char *> free;
+		};
+
+		sizeClass classes[CLASSES];
+		bool huge = false;
+
+		std::mutex slabLock;
+		std::vector<char *> slabList; // in order of mapping, index is stable
+
+		std::atomic<unsigned long> slabs;
+		std::atomic<unsigned long> hugeSlabs;
+
+		TFTPBufferPool();
+		static unsigned int find(std::size_t size);
+		void carve(sizeClass & free, std::size_t size);
+
+	public:
+		static TFTPBufferPool & instance();
+
+		void setHuge(bool huge);
+		char * acquire(std::size_t size);
+		void release(char * buffer, std::size_t size);
+		static std::size_t capacity(std::size_t size);
+		int slab(const char * buffer, char * & base);
+		void print();
+};
+
+#endif
@@ -1,28 +1,41 @@
 #include "tftpclient.h"
 
+std::atomic<bool> TFTPClient::gsoSupported(true);
+const long long TFTPClient::INITIAL_RTO = 1000000;
+const long long TFTPClient::MIN_RTO = 10000;
+const unsigned int TFTPClient::MAX_SEGMENTS = 64;
+
 /**
  * @brief Create new socket, start new thread
  * @param address address of interface
- * @param inaddr client sockaddr
+ * @param inaddr client sockaddr, copied
  * @param buffer first message from client
  * @param socklen size of inaddr
  * @param params
  * @param blocksize max blocksize on dev
+ * @param key request registered in request table, owned by table and released with session
  */
-TFTPClient::TFTPClient(std::string & address, sockaddr * inaddr, socklen_t socklen, char * buffer, int length, Params params, unsigned int blocksize)
+TFTPClient::TFTPClient(std::string & address, const sockaddr * inaddr, socklen_t socklen, char * buffer, int length, const Params & params, unsigned int blocksize, const std::string * key)
 {
-	unsigned int requiredLength;
 	this->ipv6 = socklen == sizeof(sockaddr_in6);
 	this->socklen = socklen;
-	this->inaddr = inaddr;
-	this->saveClientAddress(inaddr, ipv6);
+	this->inaddr = (sockaddr *) &this->client;
+	memcpy(this->inaddr, inaddr, socklen);
+	this->target = this->inaddr;
+	this->targetLength = socklen;
+	this->request = key;
+
+	this->sck = Params::NOT_SET;
 
 	try
 	{
-		this->sck = TFTPServer::createSocket(address, 0, ipv6);
-		this->setDefaults(params.timeout, params.blocksize == Params::NOT_SET ? blocksize : params.blocksize, params.dir);
-		requiredLength = this->required(buffer);
-		this->optional(buffer + requiredLength, length - requiredLength);
+		this->local = TFTPSessionTable::instance().intern(address);
+		this->sck = TFTPSocketPool::instance().acquire(address, ipv6);
+		this->connectClient();
+		this->setDefaults(params.timeout, params.blocksize == Params::NOT_SET ? blocksize : params.blocksize, params.dir, params.rollover, params.retries);
+		TFTPRequest request(buffer, length);
+		this->required(request);
+		this->optional(request);
 	}
 	catch(TFTPProtocolException & e)
 	{
@@ -37,31 +50,126 @@ TFTPClient::TFTPClient(std::string & address, sockaddr * inaddr, socklen_t sockl
 }
 
 /**
- * @brief Destruct object, release sockaddr structure
+ * @brief Sessions live in contiguous session table
+ * @param size size of session
+ * @return slot
+ */
+void * TFTPClient::operator new(std::size_t size)
+{
+	return TFTPSessionTable::instance().acquire(size);
+}
+
+/**
+ * @brief Return slot to session table
+ * @param session slot
+ */
+void TFTPClient::operator delete(void * session)
+{
+	TFTPSessionTable::instance().release(session);
+}
+
+/**
+ * @brief Destruct object, release socket and file
  */
 TFTPClient::~TFTPClient()
 {
-	delete this->inaddr;
+	if(this->wheel != nullptr)
+	{
+		this->wheel->cancel(&this->timer);
+	}
+
+	if(this->file != NULL)
+	{
+		fclose(this->file);
+	}
+
+	if(this->upload != nullptr)
+	{
+		TFTPWriter::instance().forget(this->upload);
+	}
+
+	this->unmap();
+	delete this->netascii;
+
+	if(this->ring != nullptr)
+	{
+		this->ring->unregisterFile(this->slot);
+	}
+
+	for(outgoing * entry = this->spare; entry != nullptr; entry = entry->next)
+	{
+		TFTPBufferPool::instance().release(entry->copy, entry->copySize);
+	}
+
+	for(outgoing * entry = this->reading; entry != nullptr; entry = entry->next)
+	{
+		TFTPBufferPool::instance().release(entry->copy, entry->copySize);
+	}
+
+	TFTPBufferPool::instance().release(this->buffer, this->bufferSize);
+	TFTPBufferPool::instance().release(this->incoming, this->bufferSize);
+
+	if(this->multicast != nullptr)
+	{
+		TFTPMulticast::release(this->multicast);
+	}
+
+	if(this->sck != Params::NOT_SET)
+	{
+		TFTPSocketPool::instance().release(*this->local, this->sck);
+	}
+
+	if(this->request != nullptr)
+	{
+		TFTPRequestTable::instance().remove(this->request);
+	}
+
+	if(TFTPAdmission::instance().enabled())
+	{
+		TFTPAdmission::instance().leave(this);
+	}
 }
 
-void TFTPClient::saveClientAddress(sockaddr * inaddr, bool ipv6)
+/**
+ * @brief Address and port of client, made only for messages
+ * @return address:port
+ */
+std::string TFTPClient::clientAddress()
 {
+	char ipAddress[INET6_ADDRSTRLEN];
 	unsigned short port;
 
-	if(ipv6)
+	if(this->ipv6)
 	{
-		char ipAddress[INET6_ADDRSTRLEN];
-		inet_ntop(AF_INET6, &(((sockaddr_in6 *) inaddr)->sin6_addr), ipAddress, INET6_ADDRSTRLEN);
-		port = ntohs(((sockaddr_in6 *) inaddr)->sin6_port);
-		this->addressPort.assign(ipAddress).append(":").append(std::to_string(port));
+		inet_ntop(AF_INET6, &(((sockaddr_in6 *) this->inaddr)->sin6_addr), ipAddress, INET6_ADDRSTRLEN);
+		port = ntohs(((sockaddr_in6 *) this->inaddr)->sin6_port);
 	}
 	else
 	{
-		char ipAddress[INET_ADDRSTRLEN];
-		inet_ntop(AF_INET, &(((sockaddr_in *) inaddr)->sin_addr), ipAddress, INET_ADDRSTRLEN);
-		port = ntohs(((sockaddr_in *) inaddr)->sin_port);
-		this->addressPort.assign(ipAddress).append(":").append(std::to_string(port));
+		inet_ntop(AF_INET, &(((sockaddr_in *) this->inaddr)->sin_addr), ipAddress, INET_ADDRSTRLEN);
+		port = ntohs(((sockaddr_in *) this->inaddr)->sin_port);
+	}
+
+	return std::string(ipAddress).append(":").append(std::to_string(port));
+}
+
+/**
+ * @brief Connect socket to client, datagrams left from previous transfer on pooled socket are dropped
+ */
+void TFTPClient::connectClient()
+{
+	char stale;
+	int error;
+	socklen_t length = sizeof(error);
+
+	if(::connect(this->sck, this->inaddr, this->socklen) != 0)
+	{
+		throw TFTPException(TFTPException::SOCKET, errno);
 	}
+
+	while(recv(this->sck, &stale, sizeof(stale), MSG_DONTWAIT | MSG_TRUNC) >= 0);
+
+	getsockopt(this->sck, SOL_SOCKET, SO_ERROR, &error, &length); // clear pending ICMP error
 }
 
 /**
@@ -69,20 +177,28 @@ void TFTPClient::saveClientAddress(sockaddr * inaddr, bool ipv6)
  * @param timeout max acceptable value
  * @param blocksize max acceptable value
  * @param dir working directory
+ * @param rollover block number following 65535 unless client asks otherwise
+ * @param retries max number of retransmissions of single packet
  */
-void TFTPClient::setDefaults(int timeout, int blocksize, std::string dir)
+void TFTPClient::setDefaults(int timeout, int blocksize, const std::string & dir, int rollover, int retries)
 {
+	this->maxRetries = retries;
+	this->defaultRollover = rollover;
 	this->maxBlocksize = blocksize;
 	this->maxTimeout = timeout;
-	this->dir = dir;
+	this->dir = TFTPSessionTable::instance().intern(dir);
 }
 
 /**
- * @brief Main function of client
+ * @brief Start transfer, send first packet to client
  */
-void TFTPClient::work()
+void TFTPClient::start()
 {
-	if(this->failed) return;
+	if(this->failed)
+	{
+		this->finished = true;
+		return;
+	}
 
 	try
 	{
@@ -90,569 +206,1815 @@ void TFTPClient::work()
 	} catch(TFTPProtocolException & e)
 	{
 		this->error(e.getCode());
+		this->finished = true;
 	} catch(TFTPException & e)
 	{
+		this->finished = true;
+	}
+}
+
+/**
+ * @brief Read every datagram waiting on client socket
+ */
+void TFTPClient::receive()
+{
+	int bytes;
+
+	while(!this->finished)
+	{
+		// socket is connected, kernel drops datagrams of other senders
+		bytes = recv(this->sck, this->buffer, this->bufferSize, 0);
 
+		if(bytes < 0)
+		{
+			break; // EAGAIN, nothing more to read, or ICMP error of client
+		}
+
+		this->process(this->buffer, bytes);
 	}
+}
 
+/**
+ * @brief Handle received datagram, protocol error ends session
+ * @param data datagram
+ * @param bytes size of datagram
+ */
+void TFTPClient::process(const char * data, int bytes)
+{
+	try
+	{
+		this->handle(data, bytes);
+	} catch(TFTPProtocolException & e)
+	{
+		this->error(e.getCode());
+		this->finished = true;
+	} catch(TFTPException & e)
+	{
+		this->finished = true;
+	}
 }
 
 /**
- * @brief Send data packet
- * @param blockid
- * @param data
+ * @brief Queue receive of next datagram to ring
  */
-void TFTPClient::data(unsigned short blockid, const char * data, unsigned int length)
+void TFTPClient::post()
 {
-	char * output = new char[length + 2];
-	memset(output, 0, length + 2);
+	io_uring_sqe * sqe = this->ring->next();
+
+	if(this->incoming == nullptr)
+	{
+		this->incoming = TFTPBufferPool::instance().acquire(this->bufferSize); // sized by negotiated blocksize
+	}
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = this->slot >= 0 ? this->slot : this->sck;
+	sqe->flags = this->slot >= 0 ? IOSQE_FIXED_FILE : 0;
+	sqe->addr = (uint64_t) this->incoming;
+	sqe->len = this->bufferSize;
+	sqe->user_data = (uint64_t) &this->receiving;
 
-	this->twoByte(blockid, output);
-	memcpy(output+2, data, length);
-	this->message(DATA, output, length + 2);
-	delete[] output;
+	this->receivePending = true;
+	++this->inflight;
 }
 
 /**
- * @brief Send ack
- * @param blockid
+ * @brief Operation queued by session completed
+ * @param op operation
+ * @param result result of operation, received or read bytes or -errno
  */
-void TFTPClient::ack(unsigned short blockid)
+void TFTPClient::complete(TFTPRing::operation * op, int result)
 {
-	char msg[2];
-	this->twoByte(blockid, msg);
-	this->message(ACK, msg, 2);
+	outgoing * entry = (outgoing *) op->data;
+
+	--this->inflight;
+
+	if(op->type == TFTPRing::SEND)
+	{
+		entry->next = this->spare; // datagram is sent or dropped, timeout resends it
+		this->spare = entry;
+		return;
+	}
+
+	if(op->type == TFTPRing::READ && entry->stale)
+	{
+		entry->next = this->spare;
+		this->spare = entry;
+		return;
+	}
+
+	if(op->type == TFTPRing::READ)
+	{
+		// file truncated meanwhile or read error ends transfer by shorter block, as pread does
+		entry->length = std::max(std::min(result, entry->length), 0);
+		entry->ready = true;
+		this->sendReads();
+		return;
+	}
+
+	this->receivePending = false;
+
+	if(result == -ECANCELED || this->finished)
+	{
+		return;
+	}
+
+	if(result >= 0)
+	{
+		this->process(this->incoming, result);
+	}
+
+	// ICMP error of client is skipped like with recv
+	if(!this->finished)
+	{
+		this->post();
+	}
 }
 
 /**
- * @brief Send error with errorcode
- * @param errcode
+ * @brief Stop timer and pending receive of finished session
  */
-void TFTPClient::error(unsigned short errcode)
+void TFTPClient::cancel()
 {
-	char msg[2];
-	this->twoByte(errcode, msg);
-	this->message(ERROR, msg, 2);
-	this->debug(std::string("ERROR: ") + std::to_string(errcode));
+	io_uring_sqe * sqe;
+
+	if(this->wheel != nullptr)
+	{
+		this->wheel->cancel(&this->timer);
+	}
+
+	if(this->ring != nullptr && this->receivePending)
+	{
+		sqe = this->ring->next();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = (uint64_t) &this->receiving;
+		sqe->user_data = 0; // completion of cancel is ignored
+	}
 }
 
 /**
- * @brief Send ack of options
- * @param file pointer to netascii file, value of tsize must be changed
+ * @brief Has kernel finished every operation of session?
+ * @return true if session can be destroyed
+ */
+bool TFTPClient::isIdle()
+{
+	return this->inflight == 0;
+}
+
+/**
+ * @brief Deadline passed, retransmit last packet or give up
  */
- void TFTPClient::oack(FILE * file)
+void TFTPClient::expire()
 {
-	std::vector<unsigned char> data;
-	int tsize = this->tsize;
+	if(this->finished) return;
 
-	for(optionVector::iterator it = this->options.begin(); it!= this->options.end(); ++it)
+	try
 	{
-		std::copy(it->first.begin(), it->first.end(), std::back_inserter(data));
-		data.push_back('\0');
+		if(this->settling)
+		{
+			this->settle();
+			return;
+		}
 
-		if(this->opcode == RRQ && it->first == "tsize")
+		if(this->throttled)
 		{
-			if(file != NULL)
+			this->window(); // rate limit lets window go, not a retransmission
+			return;
+		}
+
+		if(++this->retries > this->maxRetries)
+		{
+			this->debug("Timeout");
+
+			if(this->multicast != nullptr)
 			{
-				fseek(file, 0L, SEEK_END);
-				tsize = ftell(file);
-				rewind(file);
+				this->nextMaster(); // master is gone, let other client continue
 			}
-			it->second = std::to_string(tsize);
+			else
+			{
+				this->finished = true;
+			}
+
+			return;
 		}
 
-		std::copy( it->second.begin(), it->second.end(), std::back_inserter(data));
-		data.push_back('\0');
+		// exponential backoff
+		this->rto = std::min(this->rto * 2, this->maxRto());
+		this->resend();
+		this->arm();
+	} catch(TFTPProtocolException & e)
+	{
+		this->error(e.getCode());
+		this->finished = true;
 	}
+}
+
+/**
+ * @brief Writer caught up with upload, acknowledge deferred window or last block,
+ * notification may be stale (session already resumed)
+ */
+void TFTPClient::resume()
+{
+	if(this->finished) return;
+
+	try
+	{
+		if(this->settling)
+		{
+			this->settle();
+			return;
+		}
 
-	this->message(OACK, data.data(), data.size());
+		if(!this->deferred || TFTPWriter::instance().wait(this->upload, this->loop, this))
+		{
+			return;
+		}
+
+		this->deferred = false;
+		this->wrqReply(this->block);
+		this->acked = this->block;
+		this->arm();
+	} catch(TFTPProtocolException & e)
+	{
+		this->error(e.getCode());
+		this->finished = true;
+	}
 }
 
 /**
- * @brief Send general message, prepends opcode
- * @param opcode code of operation
- * @param data
+ * @brief Is transfer over (successfully or not)?
+ * @return finished flag, also set if request was invalid
  */
-void TFTPClient::message(unsigned short opcode, const void * data, unsigned int length)
+bool TFTPClient::isDone()
 {
-	char * message = new char[length+2];
-	memset(message, 0, length + 2);
+	return this->finished || this->failed;
+}
 
-	this->twoByte(opcode, message);
-	memcpy(message + 2, data, length);
+/**
+ * @brief Refuse request over session limits, client gets error before its first packet
+ */
+void TFTPClient::reject()
+{
+	this->debug("Server busy");
+	this->error(TFTPProtocolException::UNDEFINED, "Server busy");
+	this->finished = true;
+}
 
-	sendto(this->sck, message, length + 2, 0, this->inaddr, this->socklen);
-	delete[] message;
+/**
+ * @brief Address of client
+ * @return sockaddr
+ */
+const sockaddr * TFTPClient::getAddress()
+{
+	return this->inaddr;
 }
 
 /**
- * @brief Make two byte string from number
- * @param num
- * @param result
+ * @brief Requested file relative to working directory
+ * @return filename
  */
-void TFTPClient::twoByte(unsigned short num, char * result)
+const char * TFTPClient::getFilename()
 {
-	result[1] = num;
-	result[0] = num >> 8;
+	return this->filename;
 }
 
 /**
- * @brief Only in initial packet
- * @details [long description]
- *
- * @param data [description]
- * @return [description]
+ * @brief Requested file with working directory, built when file is opened or invalidated
+ * @return path
  */
-unsigned int TFTPClient::required(const char * data)
+std::string TFTPClient::path()
 {
-	char filename[512] = {0};
-	char mode[9] = {0}; //netascii, octet
+	return std::string(*this->dir).append("/").append(this->filename);
+}
 
-	this->opcode = ((unsigned char) data[1]) | (unsigned char) data[0] << 8;
-	sscanf(data+2, "%s", filename);
-	sscanf(data+2+strlen(filename)+1, "%s", mode);
+/**
+ * @brief Is session read request?
+ * @return true for RRQ
+ */
+bool TFTPClient::isRead()
+{
+	return this->opcode == RRQ;
+}
 
-	if(this->opcode != WRQ && this->opcode != RRQ)
-	{
-		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
-	}
+/**
+ * @brief Socket used for this transfer
+ * @return socket descriptor
+ */
+int TFTPClient::getSocket()
+{
+	return this->sck;
+}
 
-	strtolower(mode);
-	if(strcmp(mode, "netascii") == 0)
-	{
-		this->mode = NETASCII;
-	}
-	else if(strcmp(mode, "octet") == 0)
-	{
-		this->mode = OCTET;
-	}
-	else
-	{
-		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
-	}
+/**
+ * @brief Event loop owning session, must precede start
+ * @param loop event loop
+ */
+void TFTPClient::setLoop(TFTPEventLoop * loop)
+{
+	this->loop = loop;
+}
 
-	this->filename.assign(this->dir).append("/").append(filename);
+/**
+ * @brief Use io_uring of event loop for socket operations, must precede start
+ * @param ring ring of event loop
+ */
+void TFTPClient::setRing(TFTPRing * ring)
+{
+	this->ring = ring;
+	this->slot = ring->registerFile(this->sck);
+	this->receiving.type = TFTPRing::RECEIVE;
+	this->receiving.owner = this;
+	this->receiving.data = nullptr;
+	this->gso = false; // one SENDMSG per datagram
+}
 
-	std::string debugMsg = this->opcode == RRQ ? "RRQ" : "WRQ";
-	debugMsg += " file=";
-	debugMsg += filename;
-	debugMsg += ", mode=";
-	debugMsg += mode;
-	this->debug(debugMsg);
+/**
+ * @brief Attach session to timer wheel of its event loop, must precede start
+ * @param wheel timer wheel
+ */
+void TFTPClient::setWheel(TFTPTimerWheel * wheel)
+{
+	this->wheel = wheel;
+	this->timer.owner = this;
+}
 
-	return 2 + strlen(filename) + 1 + strlen(mode) + 1; //délka povinných parametrů
+/**
+ * @brief Send data packet, payload is passed to kernel without copying
+ * @param blockid
+ * @param data
+ */
+void TFTPClient::data(unsigned short blockid, const char * data, unsigned int length)
+{
+	char header[4];
+	iovec iov[2];
+
+	this->twoByte(DATA, header);
+	this->twoByte(blockid, header + 2);
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = 4;
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = length;
+
+	this->send(iov, 2, this->target, this->targetLength);
 }
 
 /**
- * @brief Print debug info
- * @param msg message
+ * @brief Send ack
+ * @param blockid
  */
-void TFTPClient::debug(std::string msg)
+void TFTPClient::ack(unsigned short blockid)
 {
-	std::time_t now = std::time(NULL);
-	tm * info;
-	char buffer[80] = {0};
+	char msg[2];
+	this->twoByte(blockid, msg);
+	this->message(ACK, msg, 2);
+}
 
-	info = localtime(&now);
-	strftime(buffer, 80, "%Y-%m-%d %H:%m:%S", info);
-	std::cout << "[" << buffer << "] " << this->addressPort << " # " << msg << std::endl;
+/**
+ * @brief Send error with errorcode
+ * @param errcode
+ * @param text message for user, needed with UNDEFINED code
+ */
+void TFTPClient::error(unsigned short errcode, const std::string & text)
+{
+	char msg[2 + MAX_ERROR + 1] = {0};
+	std::size_t length = std::min<std::size_t>(text.size(), MAX_ERROR);
+
+	this->twoByte(errcode, msg);
+	memcpy(msg + 2, text.c_str(), length);
+	this->message(ERROR, msg, 2 + length + 1); // message is terminated by zero
+	this->debug(std::string("ERROR: ") + std::to_string(errcode));
 }
 
 /**
- * @brief Make lower case
- * @param str original string
+ * @brief Send ack of options, tsize of netascii RRQ is size after conversion
  */
-void TFTPClient::strtolower(char * str)
+void TFTPClient::oack()
 {
-	while(*str != '\0') *str = tolower(*str), str++;
+	this->oack(this->multicast, true);
+}
+
+/**
+ * @brief Send ack of options
+ * @param group multicast transfer announced in multicast option
+ * @param master client is master of group
+ */
+void TFTPClient::oack(TFTPMulticast * group, bool master)
+{
+	char data[MAX_OACK];
+	unsigned int length = 0;
+	std::string value;
+
+	for(unsigned int i = 0; i < this->optionCount; ++i)
+	{
+		option & item = this->options[i];
+
+		if(this->opcode == RRQ && strcmp(item.name, "tsize") == 0)
+		{
+			item.value = this->netascii != nullptr ? this->netascii->length() : this->tsize;
+		}
+
+		if(strcmp(item.name, "multicast") == 0)
+		{
+			if(group == nullptr)
+			{
+				continue;
+			}
+
+			value = group->option(master);
+		}
+		else
+		{
+			value = std::to_string(item.value);
+		}
+
+		// options come from single request datagram, only values grow (tsize, multicast)
+		if(length + strlen(item.name) + value.size() + 2 > sizeof(data))
+		{
+			break;
+		}
+
+		memcpy(data + length, item.name, strlen(item.name) + 1);
+		length += strlen(item.name) + 1;
+		memcpy(data + length, value.c_str(), value.size() + 1);
+		length += value.size() + 1;
+	}
+
+	this->message(OACK, data, length);
+}
+
+/**
+ * @brief Send general message, prepends opcode
+ * @param opcode code of operation
+ * @param data
+ */
+void TFTPClient::message(unsigned short opcode, const void * data, unsigned int length)
+{
+	char header[2];
+	iovec iov[2];
+
+	this->twoByte(opcode, header);
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = 2;
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = length;
+
+	this->send(iov, 2, this->inaddr, this->socklen);
+}
+
+/**
+ * @brief Gather buffers into single datagram
+ * @param iov buffers
+ * @param count number of buffers
+ * @param to destination address
+ * @param tolen size of destination address
+ */
+void TFTPClient::send(iovec * iov, unsigned int count, const sockaddr * to, socklen_t tolen)
+{
+	msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = (void *) to;
+	msg.msg_namelen = tolen;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+
+	if(this->ring != nullptr)
+	{
+		this->queue(&msg);
+		return;
+	}
+
+	sendmsg(this->sck, &msg, 0);
+}
+
+/**
+ * @brief Queue datagram to ring, payload outside of file in memory is copied
+ * @param msg datagram of at most two buffers
+ */
+void TFTPClient::queue(const msghdr * msg)
+{
+	outgoing * entry;
+	std::size_t copied = 0;
+	char * copy;
+	const char * base;
+
+	for(std::size_t i = 0; i < msg->msg_iovlen; ++i)
+	{
+		copied += msg->msg_iov[i].iov_len;
+	}
+
+	entry = this->take(copied);
+
+	memset(&entry->msg, 0, sizeof(entry->msg));
+	memcpy(&entry->name, msg->msg_name, msg->msg_namelen);
+	entry->msg.msg_name = &entry->name;
+	entry->msg.msg_namelen = msg->msg_namelen;
+	entry->msg.msg_iov = entry->iov;
+	entry->msg.msg_iovlen = msg->msg_iovlen;
+
+	copy = entry->copy;
+	copied = 0;
+
+	for(std::size_t i = 0; i < msg->msg_iovlen; ++i)
+	{
+		base = (const char *) msg->msg_iov[i].iov_base;
+		entry->iov[i].iov_len = msg->msg_iov[i].iov_len;
+
+		// mapped or cached file stays until session is destroyed
+		if(this->inMemory && base >= this->memory && base < this->memory + this->memorySize)
+		{
+			entry->iov[i].iov_base = (void *) base;
+			continue;
+		}
+
+		memcpy(copy + copied, base, msg->msg_iov[i].iov_len);
+		entry->iov[i].iov_base = copy + copied;
+		copied += msg->msg_iov[i].iov_len;
+	}
+
+	this->transmit(entry);
+}
+
+/**
+ * @brief Queue prepared datagram to ring
+ * @param entry datagram, returned to spare on completion
+ */
+void TFTPClient::transmit(outgoing * entry)
+{
+	io_uring_sqe * sqe = this->ring->next();
+
+	entry->op.type = TFTPRing::SEND;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = this->slot >= 0 ? this->slot : this->sck;
+	sqe->flags = this->slot >= 0 ? IOSQE_FIXED_FILE : 0;
+	sqe->addr = (uint64_t) &entry->msg;
+	sqe->len = 1;
+	sqe->user_data = (uint64_t) &entry->op;
+
+	++this->inflight;
+}
+
+/**
+ * @brief Get datagram of ring, completed one is reused
+ * @param size bytes which must fit into copy
+ * @return datagram, not queued yet
+ */
+TFTPClient::outgoing * TFTPClient::take(std::size_t size)
+{
+	outgoing * entry;
+
+	if(this->spare == nullptr)
+	{
+		entry = new(this->arena.allocate(sizeof(outgoing))) outgoing;
+		entry->op.owner = this;
+		entry->op.data = entry;
+		entry->copySize = std::max<std::size_t>(std::max(size, this->bufferSize), MAX_OACK);
+		entry->copy = TFTPBufferPool::instance().acquire(entry->copySize);
+		entry->fixed = this->ringRead ? this->ring->registerBuffer(entry->copy) : UNDEFINED;
+	}
+	else
+	{
+		entry = this->spare;
+		this->spare = entry->next;
+	}
+
+	if(size > entry->copySize)
+	{
+		// entry made before blocksize was negotiated
+		TFTPBufferPool::instance().release(entry->copy, entry->copySize);
+		entry->copySize = size;
+		entry->copy = TFTPBufferPool::instance().acquire(entry->copySize);
+		entry->fixed = this->ringRead ? this->ring->registerBuffer(entry->copy) : UNDEFINED;
+	}
+
+	return entry;
+}
+
+/**
+ * @brief Queue read of block by kernel right behind header of its datagram (READ_FIXED into registered slab)
+ * @param blockid block to read
+ * @return expected length of payload, DATA is sent once read and reads of preceding blocks complete
+ */
+int TFTPClient::submitRead(unsigned int blockid)
+{
+	long long offset = (long long) (blockid - 1) * this->blocksize;
+	outgoing * entry = this->take(this->bufferSize);
+	io_uring_sqe * sqe;
+
+	entry->op.type = TFTPRing::READ;
+	entry->blockid = blockid;
+	entry->length = offset >= this->readSize ? 0 : std::min<long long>(this->blocksize, this->readSize - offset);
+	entry->ready = entry->length == 0; // empty last block
+	entry->stale = false;
+	entry->next = nullptr;
+
+	if(this->readingTail == nullptr)
+	{
+		this->reading = entry;
+	}
+	else
+	{
+		this->readingTail->next = entry;
+	}
+
+	this->readingTail = entry;
+
+	if(entry->ready)
+	{
+		return 0;
+	}
+
+	sqe = this->ring->next();
+	sqe->opcode = entry->fixed >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe->fd = this->source->fd;
+	sqe->addr = (uint64_t) (entry->copy + 4);
+	sqe->len = entry->length;
+	sqe->off = offset;
+	sqe->buf_index = entry->fixed >= 0 ? entry->fixed : 0;
+	sqe->user_data = (uint64_t) &entry->op;
+
+	++this->inflight;
+
+	return entry->length;
+}
+
+/**
+ * @brief Drop reads of rewound window, blocks are read again; completed ones are reused at once,
+ * pending ones once kernel completes them
+ */
+void TFTPClient::discardReads()
+{
+	outgoing * entry;
+
+	while(this->reading != nullptr)
+	{
+		entry = this->reading;
+		this->reading = entry->next;
+
+		if(entry->ready)
+		{
+			entry->next = this->spare;
+			this->spare = entry;
+		}
+		else
+		{
+			entry->stale = true;
+		}
+	}
+
+	this->readingTail = nullptr;
+}
+
+/**
+ * @brief Send DATA of completed reads, blocks leave in order even if kernel completes them out of order
+ */
+void TFTPClient::sendReads()
+{
+	outgoing * entry;
+
+	while(this->reading != nullptr && this->reading->ready)
+	{
+		entry = this->reading;
+		this->reading = entry->next;
+
+		if(this->reading == nullptr)
+		{
+			this->readingTail = nullptr;
+		}
+
+		// only blocks of current window, rollback may have rewound it meanwhile
+		if(this->finished || entry->blockid <= this->acked || entry->blockid > this->block)
+		{
+			entry->next = this->spare;
+			this->spare = entry;
+			continue;
+		}
+
+		this->twoByte(DATA, entry->copy);
+		this->twoByte(this->wire(entry->blockid), entry->copy + 2);
+
+		memset(&entry->msg, 0, sizeof(entry->msg));
+		memcpy(&entry->name, this->target, this->targetLength);
+		entry->iov[0].iov_base = entry->copy;
+		entry->iov[0].iov_len = 4 + entry->length;
+		entry->msg.msg_name = &entry->name;
+		entry->msg.msg_namelen = this->targetLength;
+		entry->msg.msg_iov = entry->iov;
+		entry->msg.msg_iovlen = 1;
+
+		this->transmit(entry);
+	}
+}
+
+/**
+ * @brief Make two byte string from number
+ * @param num
+ * @param result
+ */
+void TFTPClient::twoByte(unsigned short num, char * result)
+{
+	result[1] = num;
+	result[0] = num >> 8;
+}
+
+/**
+ * @brief Operation, filename and mode of initial packet
+ * @param request parsed request
+ */
+void TFTPClient::required(const TFTPRequest & request)
+{
+	const TFTPRequest::view & mode = request.getMode();
+
+	this->opcode = request.getOpcode();
+
+	if(this->opcode != WRQ && this->opcode != RRQ)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+	}
+
+	if(mode.equals("netascii"))
+	{
+		this->mode = NETASCII;
+	}
+	else if(mode.equals("octet"))
+	{
+		this->mode = OCTET;
+	}
+	else
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+	}
+
+	if(request.getFilename().length > MAX_FILENAME)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+	}
+
+	// key ends with the same name and is terminated, session keeps no copy
+	this->filename = this->request->c_str() + this->request->size() - request.getFilename().length;
+
+	std::string debugMsg = this->opcode == RRQ ? "RRQ" : "WRQ";
+	debugMsg += " file=";
+	debugMsg += this->filename;
+	debugMsg += ", mode=";
+	debugMsg += this->mode == NETASCII ? "netascii" : "octet";
+	this->debug(debugMsg);
+}
+
+/**
+ * @brief Print debug info
+ * @param msg message
+ */
+void TFTPClient::debug(std::string msg)
+{
+	std::time_t now = std::time(NULL);
+	tm * info;
+	char buffer[80] = {0};
+
+	info = localtime(&now);
+	strftime(buffer, 80, "%Y-%m-%d %H:%m:%S", info);
+	std::cout << "[" << buffer << "] " << this->clientAddress() << " # " << msg << std::endl;
+}
+
+/**
+ * @brief Handle optional parameters from initial packet, unknown ones are ignored
+ * @param request parsed request
+ */
+void TFTPClient::optional(const TFTPRequest & request)
+{
+	const char * key;
+	long long numvalue;
+	bool save;
+
+	for(unsigned int i = 0; i < request.getCount(); ++i)
+	{
+		const TFTPRequest::option & item = request.getOption(i);
+		save = true;
+
+		if(item.key.equals("multicast")) // value is empty in request, filled when transfer starts
+		{
+			if(this->opcode == RRQ && TFTPMulticast::enabled(this->ipv6) && this->findOption("multicast") == nullptr)
+			{
+				this->debug("optional: multicast");
+				this->addOption("multicast", 0);
+			}
+
+			continue;
+		}
+
+		if(item.key.equals("tsize")) key = "tsize";
+		else if(item.key.equals("timeout")) key = "timeout";
+		else if(item.key.equals("utimeout")) key = "utimeout";
+		else if(item.key.equals("blksize")) key = "blksize";
+		else if(item.key.equals("windowsize")) key = "windowsize";
+		else if(item.key.equals("rollover")) key = "rollover";
+		else continue; // unknown
+
+		numvalue = TFTPRequest::number(item.value);
+
+		if(item.key.equals("tsize")) this->setTsize(numvalue);
+		else if(item.key.equals("timeout")) save = this->setTimeout(numvalue);
+		else if(item.key.equals("utimeout")) save = this->setUtimeout(numvalue);
+		else if(item.key.equals("blksize")) numvalue = this->setBlocksize(numvalue);
+		else if(item.key.equals("windowsize")) numvalue = this->setWindowsize(numvalue);
+		else numvalue = this->setRollover(numvalue);
+
+		if(save)
+		{
+			std::string debugMsg = "optional: ";
+			debugMsg += key;
+			debugMsg += "=";
+			debugMsg += item.value.str();
+			this->debug(debugMsg);
+
+			this->addOption(key, numvalue);
+		}
+	}
+}
+
+/**
+ * @brief Value was not defined earlier
+ * @param val value
+ */
+void TFTPClient::isUnique(long long val)
+{
+	if(val != UNDEFINED)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::OPTION);
+	}
+}
+
+/**
+ * @brief Check if file can be saved
+ */
+void TFTPClient::tryFile()
+{
+	std::string name = this->path();
+	std::ifstream ifile(name);
+	std::ofstream ofile(name);
+
+	if(ifile)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::EXISTS);
+	}
+
+	if(!ofile.good())
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ACCESS);
+	}
+
+	this->enoughSpace();
+}
+
+/**
+ * @brief Check if there is enough disk space for saving file
+ */
+void TFTPClient::enoughSpace()
+{
+	struct statvfs buf;
+
+	if(this->tsize <= 0) return; // client did not announce size
+
+	if(statvfs(this->dir->c_str(), &buf) != 0) return;
+
+	// space available to unprivileged user, root reserve excluded
+	if((unsigned long long) buf.f_bavail * buf.f_frsize < (unsigned long long) this->tsize)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::FULL);
+	}
+}
+
+
+/**
+ * @brief Start data packet flow
+ */
+void TFTPClient::proceed()
+{
+	if(this->timeout == UNDEFINED)
+	{
+		// not negotiated, estimate from round trip time
+		this->adaptive = true;
+		this->rto = std::min(std::chrono::microseconds(INITIAL_RTO), this->maxRto());
+	}
+	else
+	{
+		this->rto = std::chrono::microseconds(this->timeout);
+	}
+
+	if(this->blocksize == UNDEFINED) this->setBlocksize(512);
+	if(this->windowsize == UNDEFINED) this->setWindowsize(1);
+	if(this->rollover == UNDEFINED) this->rollover = this->defaultRollover;
+
+	this->tsizeCheck();
+	this->bufferSize = this->blocksize + 4;
+	this->buffer = TFTPBufferPool::instance().acquire(this->bufferSize);
+
+	if(this->opcode == RRQ)
+	{
+		this->rrq();
+	}
+	else
+	{
+		this->wrq();
+	}
+}
+
+/**
+ * @brief Handle read request from client, open file and send first packet
+ */
+void TFTPClient::rrq()
+{
+	std::string name = this->path();
+	struct stat info;
+
+	this->debug("Sending data");
+
+	if(TFTPShaper::instance().enabled())
+	{
+		TFTPShaper::instance().attach(this->inaddr, this->limits);
+	}
+
+	if(this->source == nullptr)
+	{
+		this->filesize(name); // opens file
+	}
+
+	if(this->mode == NETASCII)
+	{
+		posix_fadvise(this->source->fd, 0, 0, POSIX_FADV_SEQUENTIAL); // larger kernel readahead
+		this->netascii = new TFTPNetascii(this->source, name);
+
+		if(this->findOption("tsize") != nullptr && this->netascii->length() < 0)
+		{
+			this->removeOption("tsize"); // converted size is known once index is built off loop
+		}
+	}
+	else
+	{
+		this->content = TFTPFileCache::instance().get(name, this->source);
+
+		if(this->content != nullptr)
+		{
+			this->memory = this->content->data();
+			this->memorySize = this->content->size();
+			this->inMemory = true;
+		}
+		else if(this->ring != nullptr && this->findOption("multicast") == nullptr && fstat(this->source->fd, &info) == 0 && S_ISREG(info.st_mode))
+		{
+			// blocks are read by kernel, loop neither waits for disk nor takes page faults of mapping
+			this->ringRead = true;
+			this->readSize = info.st_size;
+			posix_fadvise(this->source->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+		else if(!this->map())
+		{
+			posix_fadvise(this->source->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+	}
+
+	if(this->findOption("multicast") != nullptr && this->joinMulticast())
+	{
+		return; // late joiner, group owner serves the data
+	}
+
+	if(this->optionCount != 0)
+	{
+		this->oack();
+		this->arm();
+	}
+	else
+	{
+		this->window();
+	}
+}
+
+/**
+ * @brief Handle write request from client, create file and acknowledge request
+ */
+void TFTPClient::wrq()
+{
+	this->tryFile();
+
+	this->file = TFTPWriter::instance().open(this->path(), this->tsize, this->upload);
+
+	if(this->file == NULL)
+	{
+		throw TFTPProtocolException(errno == ENOSPC ? TFTPProtocolException::FULL : TFTPProtocolException::ACCESS);
+	}
+
+	if(this->mode == NETASCII)
+	{
+		this->netascii = new TFTPNetascii(this->upload->fd); // decoder writes through file, descriptor is not read
+	}
+
+	this->wrqReply(0);
+	this->arm();
+
+	this->debug("Receiving data");
+}
+
+/**
+ * @brief Process single datagram from client
+ * @param data datagram
+ * @param bytes length of datagram
+ */
+void TFTPClient::handle(const char * data, int bytes)
+{
+	unsigned short opcoderecv;
+	unsigned short blockidrecv;
+
+	if(bytes < 4)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+	}
+
+	opcoderecv = ((unsigned char) data[0]) << 8 | (unsigned char) data[1];
+	blockidrecv = ((unsigned char) data[2]) << 8 | (unsigned char) data[3];
+
+	if(opcoderecv == ERROR)
+	{
+		this->debug("Transfer aborted by client");
+
+		if(this->multicast != nullptr)
+		{
+			this->nextMaster();
+		}
+		else
+		{
+			this->finished = true;
+		}
+	}
+	else if(this->opcode == RRQ && opcoderecv == ACK)
+	{
+		this->handleAck(blockidrecv);
+	}
+	else if(this->opcode == WRQ && opcoderecv == DATA)
+	{
+		this->handleData(blockidrecv, data + 4, bytes - 4);
+	}
+	else
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+	}
+}
+
+/**
+ * @brief ACK received during RRQ, slide window or rewind after loss
+ * @param blockid
+ */
+void TFTPClient::handleAck(unsigned short blockid)
+{
+	unsigned int acked;
+
+	if(this->multicast != nullptr)
+	{
+		acked = this->unwrap(blockid, this->block);
+
+		if(this->masterPending || acked >= this->block)
+		{
+			// master client asks for block following the last one it has
+			this->progress(!this->masterPending);
+			this->masterPending = false;
+
+			if(acked == this->memorySize / this->blocksize + 1)
+			{
+				this->nextMaster();
+				return;
+			}
+
+			this->acked = acked;
+			this->rollback();
+			this->window();
+		}
+
+		return;
+	}
+
+	if(this->block == 0 && blockid == 0)
+	{
+		this->progress(true);
+		this->window(); // OACK acknowledged
+		return;
+	}
+
+	acked = this->unwrap(blockid, this->acked);
+
+	if(acked <= this->acked || acked > this->block)
+	{
+		return; // duplicate of older ACK, don't answer (Sorcerer's Apprentice)
+	}
+
+	this->acked = acked;
+	this->progress(true);
+
+	if(this->acked == this->lastBlock)
+	{
+		this->finish();
+		return;
+	}
+
+	if(this->acked != this->block)
+	{
+		this->rollback(); // client lost part of the window
+	}
+
+	this->window();
+}
+
+/**
+ * @brief DATA received during WRQ, save block and acknowledge window
+ * @param blockid
+ * @param data payload
+ * @param bytes length of payload
+ */
+void TFTPClient::handleData(unsigned short blockid, const char * data, int bytes)
+{
+	int result;
+
+	if(this->settling || this->deferred)
+	{
+		return; // acknowledged once writer stores data
+	}
+
+	if(this->block > 0 && blockid == this->wire(this->block))
+	{
+		this->wrqReply(this->block); // our ACK was lost
+		return;
+	}
+
+	if(blockid != this->wire(this->block + 1))
+	{
+		if(this->acked != this->block)
+		{
+			this->wrqReply(this->block); // out of order, make sender rewind
+			this->acked = this->block;
+		}
+
+		return;
+	}
+
+	if(this->netascii != nullptr)
+	{
+		result = this->netascii->decode(data, bytes, this->file) ? bytes : 0;
+	}
+	else
+	{
+		result = fwrite(data, 1, bytes, this->file);
+	}
+
+	if(result != bytes)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::FULL);
+	}
+
+	this->progress(this->block == this->acked); // first block after our ACK
+	++this->block;
+
+	if(bytes < this->blocksize)
+	{
+		this->finish();
+		return;
+	}
+
+	if(this->block - this->acked >= (unsigned int) this->windowsize)
+	{
+		if(TFTPWriter::instance().wait(this->upload, this->loop, this))
+		{
+			// disk is behind, sender waits for ACK instead of loop waiting for disk
+			this->deferred = true;
+			this->wheel->cancel(&this->timer);
+			return;
+		}
+
+		this->wrqReply(this->block);
+		this->acked = this->block;
+	}
+
+	this->arm();
+}
+
+/**
+ * @brief Send every block of current window which was not sent yet
+ */
+void TFTPClient::window()
+{
+	const char * data;
+	int length;
+	unsigned int count = 0;
+	std::size_t bytes = 0;
+	char header[MAX_WINDOWSIZE][4];
+	iovec iov[2 * MAX_WINDOWSIZE];
+	std::size_t reserved = 0;
+	std::chrono::microseconds wait;
+
+	this->throttled = false;
+
+	if(!this->limits.empty() && this->block < this->acked + this->windowsize && (this->lastBlock == 0 || this->block < this->lastBlock))
+	{
+		// whole window is taken before sending, sessions sharing bucket cannot pass in the same moment
+		reserved = (std::size_t) (this->acked + this->windowsize - this->block) * (this->blocksize + 4);
+		wait = TFTPShaper::instance().reserve(this->limits, reserved);
+
+		if(wait.count() > 0)
+		{
+			this->throttled = true;
+
+			if(this->wheel != nullptr)
+			{
+				this->wheel->schedule(&this->timer, clock::now() + wait);
+			}
+
+			return;
+		}
+	}
+
+	while(this->block < this->acked + this->windowsize && (this->lastBlock == 0 || this->block < this->lastBlock))
+	{
+		if(this->ringRead)
+		{
+			data = nullptr;
+			length = this->submitRead(this->block + 1);
+		}
+		else
+		{
+			data = this->readBlock(this->block + 1, length);
+		}
+
+		++this->block;
+
+		if(length < this->blocksize)
+		{
+			this->lastBlock = this->block;
+		}
+
+		bytes += length + 4;
+
+		if(this->ringRead)
+		{
+			continue; // DATA is sent when read completes
+		}
+
+		if(!this->inMemory)
+		{
+			this->data(this->wire(this->block), data, length); // buffer is reused by next read
+			continue;
+		}
+
+		this->twoByte(DATA, header[count]);
+		this->twoByte(this->wire(this->block), header[count] + 2);
+		iov[2 * count].iov_base = header[count];
+		iov[2 * count].iov_len = 4;
+		iov[2 * count + 1].iov_base = (void *) data;
+		iov[2 * count + 1].iov_len = length;
+		++count;
+	}
+
+	if(count > 0)
+	{
+		this->sendBatch(iov, count);
+	}
+
+	if(this->ringRead)
+	{
+		this->sendReads(); // empty last block needs no read
+	}
+
+	if(reserved > bytes)
+	{
+		TFTPShaper::instance().refund(this->limits, reserved - bytes);
+	}
+
+	this->prefetch();
+	this->arm();
+}
+
+/**
+ * @brief Let kernel read following part of file into page cache while window waits for ACKs,
+ * hint is renewed after half of prefetched range is sent
+ */
+void TFTPClient::prefetch()
+{
+	long long sent = (long long) this->block * this->blocksize;
+	long long until = sent + READAHEAD;
+	std::size_t begin;
+	std::size_t end;
+
+	if(this->lastBlock != 0 || sent + READAHEAD / 2 < this->prefetched)
+	{
+		return;
+	}
+
+	if(this->mapped)
+	{
+		// page faults of next windows will not wait for disk
+		begin = std::min<std::size_t>(this->prefetched, this->memorySize) & ~((std::size_t) getpagesize() - 1);
+		end = std::min<std::size_t>(until, this->memorySize);
+
+		if(end > begin)
+		{
+			madvise((void *) (this->memory + begin), end - begin, MADV_WILLNEED);
+		}
+	}
+	else if(this->netascii != nullptr)
+	{
+		this->netascii->prefetch(READAHEAD);
+	}
+	else if(!this->inMemory && !this->ringRead)
+	{
+		posix_fadvise(this->source->fd, this->prefetched, until - this->prefetched, POSIX_FADV_WILLNEED);
+	}
+
+	this->prefetched = until;
+}
+
+/**
+ * @brief Send several data packets at once, segmented by kernel (UDP GSO) if possible, by sendmmsg otherwise
+ * @param iov header and payload of every packet
+ * @param count number of packets
+ */
+void TFTPClient::sendBatch(iovec * iov, unsigned int count)
+{
+	unsigned int sent = 0;
+	unsigned int segments;
+	int result;
+	msghdr msg;
+	mmsghdr msgs[MAX_WINDOWSIZE];
+	char control[CMSG_SPACE(sizeof(uint16_t))];
+	cmsghdr * cmsg;
+	uint16_t segment = this->blocksize + 4;
+
+	// all segments except the last one must have the same size
+	segments = std::min<unsigned int>(MAX_SEGMENTS, MAX_DATAGRAM / segment);
+
+	while(this->gso && segments > 1 && count - sent > 1)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = (void *) this->target;
+		msg.msg_namelen = this->targetLength;
+		msg.msg_iov = iov + 2 * sent;
+		msg.msg_iovlen = 2 * std::min(segments, count - sent);
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+
+		result = sendmsg(this->sck, &msg, 0);
+
+		if(result < 0)
+		{
+			if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED)
+			{
+				return; // socket buffer is full or client is gone, timeout will resend the rest
+			}
+
+			if(errno == ENOPROTOOPT || errno == EOPNOTSUPP)
+			{
+				TFTPClient::gsoSupported = false; // kernel without UDP_SEGMENT
+			}
+
+			this->gso = false; // e.g. segment bigger than path MTU
+			break;
+		}
+
+		sent += msg.msg_iovlen / 2;
+	}
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for(unsigned int i = sent; i < count; ++i)
+	{
+		msgs[i].msg_hdr.msg_name = (void *) this->target;
+		msgs[i].msg_hdr.msg_namelen = this->targetLength;
+		msgs[i].msg_hdr.msg_iov = iov + 2 * i;
+		msgs[i].msg_hdr.msg_iovlen = 2;
+	}
+
+	if(this->ring != nullptr)
+	{
+		for(unsigned int i = sent; i < count; ++i)
+		{
+			this->queue(&msgs[i].msg_hdr);
+		}
+
+		return;
+	}
+
+	while(sent < count)
+	{
+		result = sendmmsg(this->sck, msgs + sent, count - sent, 0);
+
+		if(result <= 0)
+		{
+			return; // timeout will resend the rest
+		}
+
+		sent += result;
+	}
 }
 
 /**
- * @brief Recursive handle optional parameters from initial packet
- * @param data
- * @param length of data
+ * @brief Get payload of data block, from memory (cache, mmap) or file
+ * @param blockid block to read, following previous read unless rolled back
+ * @param length length of payload
+ * @return pointer to payload
  */
-void TFTPClient::optional(char * data, unsigned int length)
+const char * TFTPClient::readBlock(unsigned int blockid, int & length)
 {
-	std::string key, value;
-	unsigned int substracted;
-	int numvalue;
-	bool save = true;
+	std::size_t offset = (std::size_t) (blockid - 1) * this->blocksize;
 
-	if(!length) // no more parameters
+	if(this->inMemory)
 	{
-		return;
+		length = offset >= this->memorySize ? 0 : std::min<std::size_t>(this->blocksize, this->memorySize - offset);
+		return this->memory + offset;
 	}
 
-	key.assign(data); // handle key
-	substracted = key.length() + 1;
+	if(this->netascii != nullptr)
+	{
+		length = this->netascii->encode(this->buffer, this->blocksize);
+		return this->buffer;
+	}
 
-	if(substracted == length)
+	// descriptor is shared by sessions, only pipes and devices (private descriptor) are read sequentially
+	if(S_ISREG(this->source->info.st_mode))
 	{
-		throw TFTPProtocolException(TFTPProtocolException::OPTION);
+		length = pread(this->source->fd, this->buffer, this->blocksize, offset);
+	}
+	else
+	{
+		length = read(this->source->fd, this->buffer, this->blocksize);
 	}
 
-	value.assign(data + key.length() + 1); // handle value
-	substracted += value.length() + 1;
-	numvalue = std::stoi(value);
+	length = std::max(length, 0);
+	return this->buffer;
+}
 
-	if(key == "tsize") this->setTsize(numvalue);
-	else if(key == "timeout") save = this->setTimeout(numvalue);
-	else if(key == "blksize") numvalue = this->setBlocksize(numvalue);
-	else save = false; // unknown
+/**
+ * @brief Join running multicast transfer of the file or start a new one (RFC 2090)
+ * @return true if client joined existing transfer and session is over
+ */
+bool TFTPClient::joinMulticast()
+{
+	std::lock_guard<std::mutex> guard(TFTPMulticast::lock);
+	std::string key = this->path() + "," + std::to_string(this->blocksize);
+	TFTPMulticast * group;
+	TFTPRing * ring = nullptr;
+	int own = this->sck;
 
-	if(save)
+	if(!this->inMemory)
 	{
-		std::string debugMsg = "optional: ";
-		debugMsg += key;
-		debugMsg += "=";
-		debugMsg += value;
-		this->debug(debugMsg);
+		this->removeOption("multicast"); // netascii is converted per session
+		return false;
+	}
+
+	// master client acknowledges every block
+	this->removeOption("windowsize");
 
-		this->options.push_back(option(key, std::to_string(numvalue)));
+	this->windowsize = 1;
+	group = TFTPMulticast::find(key);
+
+	if(group != nullptr)
+	{
+		group->join(this->inaddr, this->socklen);
+
+		// client must see the same TID as other members, sent directly from socket of group
+		this->sck = group->getSocket();
+		std::swap(ring, this->ring);
+		this->oack(group, false);
+		std::swap(ring, this->ring);
+		this->sck = own;
+
+		this->debug("Joined multicast transfer");
+		this->finished = true;
+		return true;
 	}
 
-	this->optional(data + substracted, length - substracted);
+	this->multicast = TFTPMulticast::create(key, this->sck, this->inaddr, this->socklen);
+	this->target = this->multicast->getTarget();
+	this->targetLength = this->multicast->getTargetLength();
+	this->debug("Multicast master");
+
+	return false;
 }
 
 /**
- * @brief Value was not defined earlier
- * @param val value
+ * @brief Master client has whole file or is gone, hand the role to next client
  */
-void TFTPClient::isUnique(int val)
+void TFTPClient::nextMaster()
 {
-	if(val != UNDEFINED)
+	TFTPMulticast::member master;
+
+	if(!this->multicast->next())
 	{
-		throw TFTPProtocolException(TFTPProtocolException::OPTION);
+		this->finish();
+		return;
 	}
+
+	master = this->multicast->master();
+	memcpy(this->inaddr, &master.addr, master.socklen);
+	this->socklen = master.socklen;
+	this->connectClient();
+	this->debug("Multicast master");
+
+	this->masterPending = true;
+	this->retries = 0;
+	this->oack();
+	this->arm();
 }
 
 /**
- * @brief Check if file can be saved
+ * @brief Find negotiated option
+ * @param name name of option
+ * @return option or nullptr
  */
-void TFTPClient::tryFile()
+TFTPClient::option * TFTPClient::findOption(const char * name)
 {
-	std::ifstream ifile(this->filename);
-	std::ofstream ofile(this->filename);
-
-	if(ifile)
+	for(unsigned int i = 0; i < this->optionCount; ++i)
 	{
-		throw TFTPProtocolException(TFTPProtocolException::EXISTS);
+		if(strcmp(this->options[i].name, name) == 0)
+		{
+			return &this->options[i];
+		}
 	}
 
-	if(!ofile.good())
+	return nullptr;
+}
+
+/**
+ * @brief Confirm option in OACK, in order of request
+ * @param name literal name of option
+ * @param value negotiated value
+ */
+void TFTPClient::addOption(const char * name, long long value)
+{
+	if(this->optionCount == MAX_OPTIONS)
 	{
-		throw TFTPProtocolException(TFTPProtocolException::ACCESS);
+		throw TFTPProtocolException(TFTPProtocolException::OPTION);
 	}
 
-	this->enoughSpace();
+	this->options[this->optionCount].name = name;
+	this->options[this->optionCount].value = value;
+	++this->optionCount;
 }
 
 /**
- * @brief Check if there is enough disk space for saving file
+ * @brief Drop option from OACK, keeps order of others
+ * @param name name of option
  */
-void TFTPClient::enoughSpace()
+void TFTPClient::removeOption(const char * name)
 {
-	if(this->tsize != 0) return;
-
-	struct statvfs buf;
-	statvfs(this->dir.c_str(), &buf);
+	option * item = this->findOption(name);
 
-	if(buf.f_bsize * buf.f_bfree <  (unsigned int) this->tsize)
+	if(item == nullptr)
 	{
-		throw TFTPProtocolException(TFTPProtocolException::FULL);
+		return;
 	}
-}
 
+	std::copy(item + 1, this->options + this->optionCount, item);
+	--this->optionCount;
+}
 
 /**
- * @brief Start data packet flow
+ * @brief Map file to memory for RRQ in octet mode
+ * @return false if file can't be mapped
  */
-void TFTPClient::proceed()
+bool TFTPClient::map()
 {
-	if(this->timeout == UNDEFINED) this->setTimeout(3);
-	if(this->blocksize == UNDEFINED) this->setBlocksize(512);
+	struct stat info;
+	void * mapping;
 
-	this->tsizeCheck();
+	// current size, mapping beyond end of file truncated meanwhile would fault
+	if(fstat(this->source->fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		return false;
+	}
 
-	if(this->opcode == RRQ)
+	if(info.st_size == 0)
 	{
-		this->rrq();
+		this->inMemory = true; // nothing to map, single empty block
+		return true;
 	}
-	else
+
+	mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, this->source->fd, 0);
+
+	if(mapping == MAP_FAILED)
 	{
-		this->wrq();
+		return false;
 	}
 
-	std::string debugMsg = "Transfer complete";
-	this->debug(debugMsg);
+	madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+
+	this->mapped = true;
+	this->inMemory = true;
+	this->memory = (const char *) mapping;
+	this->memorySize = info.st_size;
+
+	return true;
 }
 
 /**
- * @brief Handle read request from client (send file, receive acks)
+ * @brief Release file mapping
  */
-void TFTPClient::rrq()
+void TFTPClient::unmap()
 {
-	std::FILE * file;
-	unsigned int i = 1;
-	int result;
-	char data[this->blocksize];
-
-	this->debug("Sending data");
-
-	if(this->mode == NETASCII)
+	if(this->mapped)
 	{
-		file = this->toNetascii(this->filename);
+		munmap((void *) this->memory, this->memorySize);
+		this->mapped = false;
 	}
-	else
+}
+
+/**
+ * @brief Continue sending from first unacknowledged block
+ */
+void TFTPClient::rollback()
+{
+	if(this->lastBlock > this->acked)
 	{
-		file = fopen(this->filename.c_str(), "r");
+		this->lastBlock = 0;
 	}
 
-	if(file == NULL)
+	if(this->netascii != nullptr && this->block > this->acked)
 	{
-		throw TFTPProtocolException(TFTPProtocolException::NOTFOUND);
+		this->netascii->seek((long long) this->acked * this->blocksize);
 	}
 
-	if(!this->options.empty())
+	this->block = this->acked;
+
+	if(this->ringRead)
 	{
-		do
-		{
-			this->oack(file);
-			result = this->recvAck(0);
-		} while(result == RETRY);
+		this->discardReads();
 	}
 
-	while(!feof(file))
+	if(!this->inMemory && this->netascii == nullptr && !S_ISREG(this->source->info.st_mode))
 	{
-		result = fread(data, 1, this->blocksize, file);
-
-		do
-		{
-			this->data(i, data, result);
-			result = this->recvAck(i);
-		} while(result == RETRY);
-
-		++i;
+		lseek(this->source->fd, (off_t) this->acked * this->blocksize, SEEK_SET);
 	}
-
-	fclose(file);
 }
 
 /**
- * @brief Handle write request from client, receive data, send acks
+ * @brief Retransmit last packet (whole window during RRQ)
  */
-void TFTPClient::wrq()
+void TFTPClient::resend()
 {
-	std::FILE * file;
-	unsigned int i = 1;
-	int bytes;
-	int result;
-	char * data = new char[this->blocksize + 5];
-	memset(data, 0, this->blocksize + 5);
-
-	this->tryFile();
-
-	if(this->mode == NETASCII)
+	if(this->opcode == WRQ)
 	{
-		file = std::tmpfile();
+		this->wrqReply(this->block);
+		this->acked = this->block;
 	}
-	else
+	else if(this->block == 0 || this->masterPending)
 	{
-		file = fopen(this->filename.c_str(), "wb");
+		this->oack();
 	}
-
-	this->wrqReply(0);
-
-	this->debug("Receiving data");
-
-	do
-	{
-		do
-		{
-			bytes = this->recvData(data, i);
-			if(bytes == RETRY)
-			{
-				this->wrqReply(i-1);
-				continue;
-			}
-
-			this->ack(i);
-
-		} while(bytes == RETRY);
-
-		result = fwrite(data+4, 1, bytes, file);
-		++i;
-
-		if(result != bytes)
-		{
-			fclose(file);
-			throw TFTPProtocolException(TFTPProtocolException::FULL);
-		}
-
-		if(i == (1 << 16) - 1)
-		{
-			fclose(file);
-			throw TFTPProtocolException(TFTPProtocolException::ACCESS); // překročen maximální počet bloků
-		}
-
-	} while(bytes == this->blocksize);
-
-	if(this->mode == NETASCII)
+	else
 	{
-		this->fromNetascii(file);
+		this->rollback();
+		this->window();
 	}
-
-	fclose(file);
-
-	delete[] data;
 }
 
 /**
- * @brief Netascii to machine format
- * @param in temporary file in netascii encoding
+ * @brief Packet was sent, (re)schedule its retransmission
  */
-void TFTPClient::fromNetascii(std::FILE * in)
+void TFTPClient::arm()
 {
-	std::ofstream out(this->filename);
-	std::string line;
-	std::size_t pos = 0;
-	int c;
+	this->sentAt = clock::now();
 
-	while((c = fgetc(in)) != EOF)
+	if(this->wheel != nullptr)
 	{
-		if(c == '\n' && line.length() && line.back() == '\r')
-		{
-			line.pop_back();
-
-			while((pos = line.find("\r\0", pos)) != std::string::npos)
-			{
-				line.replace(pos, 2, "\r");
-				pos++;
-			}
-
-			out << line << std::endl;
-			line.clear();
-		}
-		else
-		{
-			line.push_back(c);
-		}
+		this->wheel->schedule(&this->timer, this->sentAt + this->rto);
 	}
 }
 
 /**
- * @brief Convert machine format to netascii tmp file
- * @param name filename
- * @return file descriptor to tmp file
+ * @brief Client answered, update round trip time estimate (RFC 6298) and reset backoff
+ * @param measure answer is to packet sent at sentAt (Karn: not after retransmission)
  */
-std::FILE * TFTPClient::toNetascii(std::string name)
+void TFTPClient::progress(bool measure)
 {
-	std::FILE * out = std::tmpfile();
-	std::ifstream in(name);
-	std::string line;
-	std::size_t pos = 0;
+	std::chrono::microseconds sample;
 
-	while(getline(in, line, '\n'))
+	if(measure && this->retries == 0 && this->adaptive)
 	{
-		while((pos = line.find('\r', pos)) != std::string::npos)
-		{
-			line.replace(pos, 1, "\r\0");
-			pos++;
-		}
-	}
-
-	return out;
-}
+		sample = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - this->sentAt);
 
-void TFTPClient::wrqReply(unsigned int i)
-{
-	if(i == 0)
+		if(this->srtt.count() == 0)
 		{
-		if(!this->options.empty())
-		{
-			this->oack();
+			this->srtt = sample;
+			this->rttvar = sample / 2;
 		}
 		else
 		{
-			this->ack(0);
+			this->rttvar = (3 * this->rttvar + (this->srtt > sample ? this->srtt - sample : sample - this->srtt)) / 4;
+			this->srtt = (7 * this->srtt + sample) / 8;
 		}
 	}
-	else
+
+	this->retries = 0;
+
+	if(!this->adaptive)
 	{
-		this->ack(i);
+		this->rto = std::chrono::microseconds(this->timeout);
+	}
+	else if(this->srtt.count() != 0)
+	{
+		this->rto = this->srtt + 4 * this->rttvar;
+		this->rto = std::max(this->rto, std::chrono::microseconds(MIN_RTO));
+		this->rto = std::min(this->rto, this->maxRto());
 	}
 }
 
 /**
- * @brief Receive data block from client
- * @param blockid
- * @return bytes of data received
+ * @brief Upper limit of retransmission timeout
+ * @return max timeout given by server parameters or negotiated timeout
  */
-int TFTPClient::recvData(char * data, unsigned int blockid)
+std::chrono::microseconds TFTPClient::maxRto()
 {
-	int bytes;
-
-	bytes = this->recv(data, this->blocksize + 4, DATA, blockid); // 2B tftp hlavička
-
-	return bytes - 4;
+	return std::chrono::microseconds(std::max((long long) this->maxTimeout * 1000000, this->timeout));
 }
 
 /**
- * @brief Receive ACK from client on data block
- * @param blockid
- * @return bytes read;
+ * @brief Transfer is complete, release file
  */
-int TFTPClient::recvAck(unsigned int blockid)
+void TFTPClient::finish()
 {
-	char data[5] = {0};
-	int bytes;
+	if(this->opcode == WRQ && this->netascii != nullptr)
+	{
+		this->netascii->flush(this->file);
+	}
+
+	if(this->file != NULL)
+	{
+		fclose(this->file);
+		this->file = NULL;
+	}
+
+	if(this->opcode == WRQ)
+	{
+		this->settling = true;
+		this->settle();
+		return;
+	}
 
-	bytes = this->recv(data, 4, ACK, blockid);
+	this->finished = true;
 
-	return bytes;
+	this->debug("Transfer complete");
 }
 
 /**
- * @brief Receive data from socket and validate opcode and blockid, ERROR opcode is permited
- * @param data pointer to allocated memory
- * @param length size of memory
- * @param opcode
- * @param blockid
- * @return bytes received
+ * @brief WRQ: acknowledge last block once writer stored whole file, poll it until then
  */
-int TFTPClient::recv(char * data, unsigned int length, unsigned short opcode, unsigned short blockid)
+void TFTPClient::settle()
 {
-	int bytes;
-	unsigned short opcoderecv;
-	unsigned short blockidrecv;
-	sockaddr_in6 inaddr6;
-	sockaddr_in inaddr;
-	sockaddr * sockptr = ipv6 ? (sockaddr *) &inaddr6 : (sockaddr *) &inaddr;
-
-	do
-	{	// skip everything which was not send by original client
-		bytes = recvfrom(this->sck, data, length, 0, sockptr, &this->socklen);
-	} while(bytes >= 4 && memcmp(this->inaddr, sockptr, this->socklen) != 0);
-
-	if(bytes == ETIMEDOUT)
+	if(TFTPWriter::instance().wait(this->upload, this->loop, this))
 	{
-		return RETRY;
+		this->wheel->cancel(&this->timer);
+		return; // loop resumes session once file is stored
 	}
-	else if(bytes < 4)
+
+	if(this->upload->error != 0)
 	{
-		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+		throw TFTPProtocolException(TFTPProtocolException::FULL);
 	}
 
-	opcoderecv = ((unsigned char) data[0]) << 8 | (unsigned char) data[1];
-	blockidrecv = ((unsigned char) data[2]) << 8 | (unsigned char) data[3];
+	std::string written = this->path();
+
+	TFTPDescriptorCache::instance().invalidate(written);
+	TFTPFileCache::instance().invalidate(written);
+	TFTPNetasciiCache::instance().invalidate(written);
+
+	this->wrqReply(this->block);
+	this->finished = true;
+
+	this->debug("Transfer complete");
+}
 
-	if(opcode == ERROR || opcode != opcoderecv || blockid != blockidrecv)
+/**
+ * @brief Acknowledge received block, first reply confirms options
+ * @param i absolute number of block
+ */
+void TFTPClient::wrqReply(unsigned int i)
+{
+	if(i == 0)
+		{
+		if(this->optionCount != 0)
+		{
+			this->oack();
+		}
+		else
+		{
+			this->ack(0);
+		}
+	}
+	else
 	{
-		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+		this->ack(this->wire(i));
 	}
-
-	return bytes;
 }
 
 /**
@@ -675,33 +2037,40 @@ std::string TFTPClient::opcode2str(unsigned short opcode)
 }
 
 /**
- * @brief Set timeout on client socket
+ * @brief Set retransmission timeout of client (RFC 2349)
  * @param seconds timeout value
  * @return save value?
  */
-bool TFTPClient::setTimeout(int seconds)
+bool TFTPClient::setTimeout(long long seconds)
 {
-	int result;
-	timeval timeout;
-	timeout.tv_sec = seconds;
-	timeout.tv_usec = 0;
-
 	this->isUnique(this->timeout);
-	this->timeout = seconds;
-
 
 	if(seconds < 1 || seconds > 255 || seconds > this->maxTimeout)
 	{
 		return false;
 	}
 
-	result = setsockopt(this->sck, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeval));
+	this->timeout = seconds * 1000000;
+
+	return true;
+}
+
+/**
+ * @brief Set retransmission timeout of client in microseconds
+ * @param useconds timeout value
+ * @return save value?
+ */
+bool TFTPClient::setUtimeout(long long useconds)
+{
+	this->isUnique(this->timeout);
 
-	if(result < 0)
+	if(useconds < MIN_RTO || useconds > 255000000 || useconds > (long long) this->maxTimeout * 1000000)
 	{
-		throw TFTPException(TFTPException::SOCKET);
+		return false;
 	}
 
+	this->timeout = useconds;
+
 	return true;
 }
 
@@ -709,7 +2078,7 @@ bool TFTPClient::setTimeout(int seconds)
  * @brief Set transfer sie
  * @param tsize value from tftp packet
  */
-void TFTPClient::setTsize(int tsize)
+void TFTPClient::setTsize(long long tsize)
 {
 	this->isUnique(this->tsize);
 
@@ -719,7 +2088,7 @@ void TFTPClient::setTsize(int tsize)
 	}
 	else // RRQ, size of file which will be send to client
 	{
-		this->tsize = this->filesize(this->filename);
+		this->tsize = this->filesize(this->path());
 	}
 }
 
@@ -727,17 +2096,17 @@ void TFTPClient::setTsize(int tsize)
  * @brief Set block size
  * @param blocksize value from tftp packet
  */
-int TFTPClient::setBlocksize(int blocksize)
+int TFTPClient::setBlocksize(long long blocksize)
 {
 	this->isUnique(this->blocksize);
 
-	this->blocksize = blocksize;
-
-	if(this->blocksize < 8 || this->blocksize > TFTPServer::MAX_BLOCKSIZE)
+	if(blocksize < 8 || blocksize > TFTPServer::MAX_BLOCKSIZE)
 	{
 		throw TFTPProtocolException(TFTPProtocolException::OPTION);
 	}
 
+	this->blocksize = blocksize;
+
 	if(blocksize > this->maxBlocksize)
 	{
 		this->blocksize = maxBlocksize;
@@ -747,29 +2116,99 @@ int TFTPClient::setBlocksize(int blocksize)
 }
 
 /**
- * @brief Get size of the file
+ * @brief Set number of blocks sent before waiting for ACK (RFC 7440)
+ * @param windowsize value from tftp packet
+ */
+int TFTPClient::setWindowsize(long long windowsize)
+{
+	this->isUnique(this->windowsize);
+
+	if(windowsize < 1 || windowsize > (1 << 16) - 1)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::OPTION);
+	}
+
+	this->windowsize = windowsize > MAX_WINDOWSIZE ? MAX_WINDOWSIZE : windowsize;
+
+	return this->windowsize;
+}
+
+/**
+ * @brief Set block number following 65535 (0 or 1)
+ * @param rollover value from tftp packet
+ */
+int TFTPClient::setRollover(long long rollover)
+{
+	this->isUnique(this->rollover);
+
+	if(rollover != 0 && rollover != 1)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::OPTION);
+	}
+
+	this->rollover = rollover;
+
+	return this->rollover;
+}
+
+/**
+ * @brief Block number on the wire, wraps to rollover base after 65535
+ * @param block absolute number of block
+ * @return two byte block number
+ */
+unsigned short TFTPClient::wire(unsigned int block)
+{
+	if(block == 0 || this->rollover == 0)
+	{
+		return block;
+	}
+
+	return (block - 1) % ((1 << 16) - 1) + 1;
+}
+
+/**
+ * @brief Absolute number of block received on the wire, nearest to reference
+ * @param blockid two byte block number
+ * @param reference absolute number of block around which blockid is expected
+ * @return absolute number of block
+ */
+unsigned int TFTPClient::unwrap(unsigned short blockid, unsigned int reference)
+{
+	long long period = this->rollover == 0 ? 1 << 16 : (1 << 16) - 1;
+	long long diff = ((long long) blockid - this->wire(reference)) % period;
+
+	if(diff < 0) diff += period;
+	if(diff >= period / 2) diff -= period;
+	if(diff < 0 && (long long) reference + diff < 0) diff = 0;
+
+	return reference + diff;
+}
+
+/**
+ * @brief Open file shared with other sessions and get its size
  * @param filename name of file
  * @return size
  */
-int TFTPClient::filesize(std::string & filename)
+long long TFTPClient::filesize(const std::string & filename)
 {
-	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if(this->source == nullptr)
+	{
+		this->source = TFTPDescriptorCache::instance().get(filename);
+	}
 
-	if(!file)
+	if(this->source == nullptr)
 	{
 		throw TFTPProtocolException(TFTPProtocolException::NOTFOUND);
 	}
 
-	return file.tellg();
+	return this->source->info.st_size;
 }
 
+/**
+ * @brief Find out size of requested file, block numbers roll over so any size can be transfered
+ */
 void TFTPClient::tsizeCheck()
 {
 	if(this->opcode == WRQ && this->tsize == UNDEFINED) return; // WRQ and no tsize option
-	if(this->tsize == UNDEFINED) this->tsize = this->filesize(this->filename);
-
-	if(this->tsize > (1 << 16) * this->blocksize)
-	{
-		throw TFTPProtocolException(TFTPProtocolException::ACCESS); // file is too big for transmision
-	}
+	if(this->tsize == UNDEFINED) this->tsize = this->filesize(this->path());
 }
@@ -6,6 +6,22 @@ class TFTPClient;
 
 #include "tftpserver.h"
 #include "tftpprotocolexception.h"
+#include "tftpfilecache.h"
+#include "tftpdescriptorcache.h"
+#include "tftpmulticast.h"
+#include "tftptimerwheel.h"
+#include "tftpnetascii.h"
+#include "tftpnetasciicache.h"
+#include "tftpsocketpool.h"
+#include "tftprequesttable.h"
+#include "tftpring.h"
+#include "tftpwriter.h"
+#include "tftpbufferpool.h"
+#include "tftparena.h"
+#include "tftprequest.h"
+#include "tftpsessiontable.h"
+#include "tftpshaper.h"
+#include "tftpadmission.h"
 #include <arpa/inet.h>
 #include <vector>
 #include <string>
@@ -14,79 +30,230 @@ class TFTPClient;
 #include <sys/socket.h>
 #include <iomanip>
 #include <ctime>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <netinet/udp.h>
+#include <atomic>
 #include "params.h"
 
 class TFTPClient
 {
 
-	const int UNDEFINED = -1;
-	const int RRQ = 1;
-	const int WRQ = 2;
-	const int DATA = 3;
-	const int ACK = 4;
-	const int ERROR = 5;
-	const int OACK = 6;
-	const int NETASCII = 7;
-	const int OCTET = 8;
-	const int RETRY = -2;
-	const int CONTINUE = -3;
-
-	using option = std::pair<std::string, std::string>;
-	using optionVector = std::vector<option>;
-
-	sockaddr * inaddr;
-	socklen_t socklen;
+	static const int UNDEFINED = -1;
+	static const int RRQ = 1;
+	static const int WRQ = 2;
+	static const int DATA = 3;
+	static const int ACK = 4;
+	static const int ERROR = 5;
+	static const int OACK = 6;
+	static const int NETASCII = 7;
+	static const int OCTET = 8;
+	static const long long INITIAL_RTO; // us, until first round trip is measured
+	static const long long MIN_RTO; // us
+	static const int MAX_WINDOWSIZE = 64;
+	static const unsigned int MAX_SEGMENTS; // UDP GSO limit of segments per call
+	static const unsigned int MAX_DATAGRAM = 65507;
+	static const unsigned int MAX_OACK = 1024; // request is at most 514 bytes
+	static const unsigned int MAX_ERROR = 64; // text of ERROR packet
+	static const unsigned int MAX_OPTIONS = 7; // every known option once
+	static const unsigned int MAX_FILENAME = 508; // request fits 512 bytes (RFC 2347)
+	static const long long READAHEAD = 1 << 20; // bytes of file read by kernel ahead of sent blocks
 
-	int sck;
-	bool ipv6;
+	static std::atomic<bool> gsoSupported;
 
-	int mode = UNDEFINED;
-	int tsize = UNDEFINED; //transfer size
-	int timeout = UNDEFINED;
+	public:
+		using clock = TFTPTimerWheel::clock;
+
+	private:
+
+	// negotiated option, value is written to OACK (multicast takes it from group)
+	struct option
+	{
+		const char * name; // literal
+		long long value;
+	};
+
+	// hot, first cache line of slot: state read by every ACK and DATA
+	int sck; // connected to client
+	unsigned short opcode;
+	bool finished = false;
+	bool failed = false;
+	unsigned int block = 0; // RRQ: last sent block, WRQ: last received block
+	unsigned int acked = 0; // last acknowledged block
+	unsigned int lastBlock = 0; // RRQ: block shorter than blocksize, 0 until read
 	int blocksize = UNDEFINED;
-	int maxBlocksize;
+	int windowsize = UNDEFINED;
+	int rollover = UNDEFINED; // block number following 65535
+	unsigned int retries = 0;
+	int mode = UNDEFINED;
+	bool inMemory = false;
+	bool mapped = false;
+	bool gso = gsoSupported;
+	bool adaptive = false; // timeout was not negotiated, derive it from round trip time
+	bool settling = false; // WRQ: last block received, waiting for writer
+	bool deferred = false; // WRQ: window is acknowledged once writer catches up
+	bool masterPending = false; // OACK sent to new master client, waiting for its ACK
+	bool receivePending = false;
+	bool throttled = false; // RRQ: timer waits for rate limit, not for ACK
+	unsigned int inflight = 0; // submitted io_uring operations not yet completed
+	const char * memory = NULL; // RRQ octet: whole file in memory (cache or mmap)
+
+	// hot, second line: packet buffer and retransmission timer
+	char * buffer = nullptr; // pooled, blocksize + 4 bytes
+	std::chrono::microseconds rto;
+	clock::time_point sentAt;
+	TFTPTimerWheel * wheel = nullptr; // wheel of loop owning session
+	TFTPTimerWheel::timer timer; // retransmission deadline
+
+	// warm, third line: sending, round trip estimate, io_uring
+	const sockaddr * target; // destination of DATA, client or multicast group
+	TFTPRing * ring = nullptr; // ring of loop owning session, nullptr with epoll
+	char * incoming = nullptr; // pooled receive buffer, kernel writes it while session runs
+	std::size_t bufferSize = 0;
+	std::chrono::microseconds srtt = std::chrono::microseconds(0);
+	std::chrono::microseconds rttvar = std::chrono::microseconds(0);
+	long long timeout = UNDEFINED; // negotiated retransmission timeout [us]
+	socklen_t targetLength;
+	int slot = UNDEFINED; // socket in registered file table
+
+	// warm only in some transfers: file in memory, read ahead, netascii, multicast
+	std::size_t memorySize = 0;
+	long long readSize = 0; // RRQ octet through ring: size of file when transfer started
+	bool ringRead = false; // RRQ octet: blocks are read by kernel into queued datagrams
+	long long prefetched = 0; // RRQ: end of file range already requested from kernel
+	TFTPNetascii * netascii = nullptr; // streaming conversion of netascii transfer
+	TFTPMulticast * multicast = nullptr; // owned group when serving multicast transfer
 	int maxTimeout;
-	unsigned short opcode;
-	std::string filename;
-	std::string dir;
+	unsigned int maxRetries;
 
-	optionVector options;
-	bool failed = false;
+	// cold: request, negotiation and setup
+	sockaddr_storage client;
+	sockaddr * inaddr; // points to client
+	socklen_t socklen;
+	bool ipv6;
+	long long tsize = UNDEFINED; //transfer size
+	const std::string * local; // address socket is bound to, interned
+	const std::string * dir; // interned
+	const std::string * request = nullptr; // key owned by request table, ends with filename
+	TFTPEventLoop * loop = nullptr; // resumes session when writer catches up
+	int defaultRollover;
+	int maxBlocksize;
+	unsigned int optionCount = 0;
+	option options[MAX_OPTIONS];
+	const char * filename = ""; // as requested, relative to dir, points into request key
+
+	std::FILE * file = NULL; // WRQ: buffered by writer
+	TFTPDescriptorCache::descriptor source; // RRQ: file shared with other sessions
+	TFTPWriter::handle upload; // WRQ: file written by writer thread
+	TFTPFileCache::content content; // RRQ octet: file served from shared cache
+	TFTPShaper::buckets limits; // RRQ: rate limits of client, empty if not shaped
+
+	// datagram queued to io_uring, buffers live until completion, reused by session
+	struct outgoing
+	{
+		TFTPRing::operation op;
+		msghdr msg;
+		iovec iov[2];
+		sockaddr_storage name;
+		char * copy; // pooled, payloads which do not outlive the call, fits DATA and OACK
+		std::size_t copySize;
+		int fixed; // registered buffer holding copy, -1 if not registered
+		unsigned int blockid; // READ: block read into copy after header
+		int length; // READ: expected payload, real one after completion
+		bool ready; // READ: completed, sent in order of blocks
+		bool stale; // READ: window was rewound, completion only returns datagram to spare
+		outgoing * next; // in list of completed datagrams or of reads
+	};
 
-	std::string addressPort;
+	TFTPRing::operation receiving; // pending receive
+	TFTPArena arena; // io_uring datagrams of session
+	outgoing * spare = nullptr; // completed datagrams
+	outgoing * reading = nullptr; // reads of blocks in order of blocks, oldest first
+	outgoing * readingTail = nullptr;
 
 	public:
-		TFTPClient(std::string & address, sockaddr * inaddr, socklen_t socklen, char * buffer, int length, Params params, unsigned int blocksize);
+		TFTPClient(std::string & address, const sockaddr * inaddr, socklen_t socklen, char * buffer, int length, const Params & params, unsigned int blocksize, const std::string * key);
+		static void * operator new(std::size_t size);
+		static void operator delete(void * session);
 		~TFTPClient();
-		void work();
-		void setDefaults(int timeout, int blocksize, std::string dir);
+		void start();
+		void receive();
+		void expire();
+		bool isDone();
+		void reject();
+		const sockaddr * getAddress();
+		const char * getFilename();
+		bool isRead();
+		int getSocket();
+		void setWheel(TFTPTimerWheel * wheel);
+		void setLoop(TFTPEventLoop * loop);
+		void resume();
+		void setRing(TFTPRing * ring);
+		void post();
+		void complete(TFTPRing::operation * op, int result);
+		void cancel();
+		bool isIdle();
+		void setDefaults(int timeout, int blocksize, const std::string & dir, int rollover, int retries);
 
 	private:
 		void tsizeCheck();
-		std::FILE * toNetascii(std::string name);
-		void fromNetascii(std::FILE * in);
 		void enoughSpace();
 		std::string opcode2str(unsigned short opcode);
 		void debug(std::string msg);
-		void strtolower(char * str);
-		void saveClientAddress(sockaddr * inaddr, bool ipv6);
-		int recvAck(unsigned int blockid);
+		std::string clientAddress();
+		void connectClient();
 		void wrqReply(unsigned int i);
-		int recvData(char * data, unsigned int blockid);
-		int recv(char * data, unsigned int length, unsigned short opcode, unsigned short blockid);
-		bool setTimeout(int seconds);
-		int setBlocksize(int blocksize);
-		void isUnique(int val);
-		void setTsize(int tsize);
-		int filesize(std::string & filename);
+		void process(const char * data, int bytes);
+		void handle(const char * data, int bytes);
+		void handleAck(unsigned short blockid);
+		void handleData(unsigned short blockid, const char * data, int bytes);
+		void window();
+		void prefetch();
+		const char * readBlock(unsigned int blockid, int & length);
+		bool joinMulticast();
+		void nextMaster();
+		option * findOption(const char * name);
+		void addOption(const char * name, long long value);
+		void removeOption(const char * name);
+		bool map();
+		void unmap();
+		void rollback();
+		void resend();
+		void arm();
+		void progress(bool measure);
+		std::chrono::microseconds maxRto();
+		void finish();
+		void settle();
+		bool setTimeout(long long seconds);
+		bool setUtimeout(long long useconds);
+		int setBlocksize(long long blocksize);
+		int setWindowsize(long long windowsize);
+		int setRollover(long long rollover);
+		unsigned short wire(unsigned int block);
+		unsigned int unwrap(unsigned short blockid, unsigned int reference);
+		void isUnique(long long val);
+		void setTsize(long long tsize);
+		long long filesize(const std::string & filename);
+		std::string path();
 		void message(unsigned short opcode, const void * data, unsigned int length);
-		void oack(FILE * file = NULL);
-		void error(unsigned short errcode);
+		void send(iovec * iov, unsigned int count, const sockaddr * to, socklen_t tolen);
+		void sendBatch(iovec * iov, unsigned int count);
+		void queue(const msghdr * msg);
+		void transmit(outgoing * entry);
+		outgoing * take(std::size_t size);
+		int submitRead(unsigned int blockid);
+		void sendReads();
+		void discardReads();
+		void oack();
+		void oack(TFTPMulticast * group, bool master);
+		void error(unsigned short errcode, const std::string & text = "");
 		void ack(unsigned short blockid);
 		void data(unsigned short blockid, const char * data, unsigned int length);
 		void proceed();
-		void optional(char * data, unsigned int length);
-		unsigned int required(const char * data);
+		void optional(const TFTPRequest & request);
+		void required(const TFTPRequest & request);
 		void rrq();
 		void wrq();
 		void twoByte(unsigned short num, char * result);
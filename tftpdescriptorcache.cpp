@@ -0,0 +1,185 @@
+#include "tftpdescriptorcache.h"
+
+/**
+ * @brief Take ownership of open file
+ * @param fd file descriptor
+ * @param info state of file
+ */
+TFTPDescriptorCache::file::file(int fd, const struct stat & info) : fd(fd), info(info)
+{
+
+}
+
+/**
+ * @brief Close file, last session and cache released it
+ */
+TFTPDescriptorCache::file::~file()
+{
+	close(this->fd);
+}
+
+TFTPDescriptorCache::TFTPDescriptorCache() : hits(0), misses(0)
+{
+
+}
+
+/**
+ * @brief Process wide cache of open files shared by all sessions
+ * @return cache
+ */
+TFTPDescriptorCache & TFTPDescriptorCache::instance()
+{
+	static TFTPDescriptorCache cache;
+	return cache;
+}
+
+/**
+ * @brief Set maximal number of cached files, 0 disables cache
+ * @param files capacity
+ */
+void TFTPDescriptorCache::setCapacity(std::size_t files)
+{
+	this->lock.lock();
+	this->capacity = files;
+	this->evict();
+	this->lock.unlock();
+}
+
+/**
+ * @brief Get open file, path is checked by stat so replaced or modified file is reopened
+ * @param path path to file
+ * @return shared file or nullptr if it can't be opened
+ */
+TFTPDescriptorCache::descriptor TFTPDescriptorCache::get(const std::string & path)
+{
+	struct stat info;
+	std::unordered_map<std::string, entryList::iterator>::iterator it;
+	descriptor result;
+
+	if(stat(path.c_str(), &info) != 0)
+	{
+		this->invalidate(path);
+		return nullptr;
+	}
+
+	this->lock.lock();
+	it = this->index.find(path);
+
+	if(it != this->index.end())
+	{
+		if(this->same(*it->second, info))
+		{
+			this->lru.splice(this->lru.begin(), this->lru, it->second);
+			result = it->second->shared;
+			this->lock.unlock();
+			++this->hits;
+			return result;
+		}
+
+		// file was replaced or modified, sessions which hold it keep old one
+		this->lru.erase(it->second);
+		this->index.erase(it);
+	}
+
+	this->lock.unlock();
+	++this->misses;
+
+	result = this->open(path);
+
+	if(result == nullptr || !S_ISREG(result->info.st_mode))
+	{
+		return result; // pipes and devices are read by single session
+	}
+
+	this->lock.lock();
+
+	if(this->capacity > 0 && this->index.find(path) == this->index.end())
+	{
+		this->lru.push_front(entry{path, result});
+		this->index[path] = this->lru.begin();
+		this->evict();
+	}
+
+	this->lock.unlock();
+
+	return result;
+}
+
+/**
+ * @brief Drop file from cache, sessions which hold it keep it open
+ * @param path path to file
+ */
+void TFTPDescriptorCache::invalidate(const std::string & path)
+{
+	std::unordered_map<std::string, entryList::iterator>::iterator it;
+
+	this->lock.lock();
+	it = this->index.find(path);
+
+	if(it != this->index.end())
+	{
+		this->lru.erase(it->second);
+		this->index.erase(it);
+	}
+
+	this->lock.unlock();
+}
+
+/**
+ * @brief Print cache statistics
+ */
+void TFTPDescriptorCache::print()
+{
+	std::cout << "Open files: " << this->hits << " hits, " << this->misses << " misses" << std::endl;
+}
+
+/**
+ * @brief Open file for reading
+ * @param path path to file
+ * @return file or nullptr
+ */
+TFTPDescriptorCache::descriptor TFTPDescriptorCache::open(const std::string & path)
+{
+	struct stat info;
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(fd < 0)
+	{
+		return nullptr;
+	}
+
+	if(fstat(fd, &info) != 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	return std::make_shared<const file>(fd, info);
+}
+
+/**
+ * @brief Cached file is still the one on path?
+ * @param item cached entry
+ * @param info current state of path
+ * @return true if file was not replaced or modified
+ */
+bool TFTPDescriptorCache::same(const entry & item, const struct stat & info)
+{
+	const struct stat & cached = item.shared->info;
+
+	return cached.st_dev == info.st_dev && cached.st_ino == info.st_ino
+		&& cached.st_mtim.tv_sec == info.st_mtim.tv_sec && cached.st_mtim.tv_nsec == info.st_mtim.tv_nsec
+		&& cached.st_size == info.st_size;
+}
+
+/**
+ * @brief Remove least recently used entries over capacity, lock must be held
+ */
+void TFTPDescriptorCache::evict()
+{
+	while(this->lru.size() > this->capacity)
+	{
+		this->index.erase(this->lru.back().path);
+		this->lru.pop_back();
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef H_TFTPDESCRIPTORCACHE
+#define H_TFTPDESCRIPTORCACHE
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+class TFTPDescriptorCache
+{
+	public:
+		// file opened for reading, shared by sessions, closed with its last user
+		struct file
+		{
+			int fd;
+			struct stat info; // state when opened
+
+			file(int fd, const struct stat & info);
+			~file();
+		};
+
+		using descriptor = std::shared_ptr<const file>;
+
+	private:
+		struct entry
+		{
+			std::string path;
+			descriptor shared;
+		};
+
+		using entryList = std::list<entry>;
+
+		std::mutex lock;
+		entryList lru; // most recently used first
+		std::unordered_map<std::string, entryList::iterator> index;
+		std::size_t capacity = 0;
+
+		std::atomic<unsigned long> hits;
+		std::atomic<unsigned long> misses;
+
+		TFTPDescriptorCache();
+		descriptor open(const std::string & path);
+		bool same(const entry & item, const struct stat & info);
+		void evict();
+
+	public:
+		static TFTPDescriptorCache & instance();
+
+		void setCapacity(std::size_t files);
+		descriptor get(const std::string & path);
+		void invalidate(const std::string & path);
+		void print();
+};
+
+#endif
@@ -0,0 +1,474 @@
+#include "tftpeventloop.h"
+#include "tftpclient.h"
+
+const int TFTPEventLoop::MAX_EVENTS = 256;
+const int TFTPEventLoop::TICK = 100; // ms
+
+/**
+ * @brief Create epoll instance and wakeup descriptor
+ * @param uring use io_uring, stays on epoll if kernel does not support it
+ * @param server server owning loop
+ * @param index position among loops of server
+ */
+TFTPEventLoop::TFTPEventLoop(bool uring, TFTPServer * server, unsigned int index) : active(0), draining(false), server(server), index(index)
+{
+	epoll_event event;
+
+	this->epollfd = epoll_create1(0);
+
+	if(this->epollfd < 0)
+	{
+		throw TFTPException(TFTPException::SOCKET, errno);
+	}
+
+	this->eventfd = ::eventfd(0, EFD_NONBLOCK);
+
+	if(this->eventfd < 0)
+	{
+		throw TFTPException(TFTPException::SOCKET, errno);
+	}
+
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr; // nullptr marks wakeup descriptor
+	epoll_ctl(this->epollfd, EPOLL_CTL_ADD, this->eventfd, &event);
+
+	if(uring)
+	{
+		try
+		{
+			this->ring = new TFTPRing();
+		}
+		catch(TFTPException & e)
+		{
+			this->ring = nullptr;
+		}
+	}
+
+	this->waking.type = TFTPRing::WAKEUP;
+	this->waking.owner = this;
+	this->waking.data = nullptr;
+}
+
+/**
+ * @brief Release descriptors and unfinished sessions
+ */
+TFTPEventLoop::~TFTPEventLoop()
+{
+	for(TFTPClient * client : this->sessions)
+	{
+		delete client;
+	}
+
+	for(TFTPClient * client : this->pending)
+	{
+		delete client;
+	}
+
+	for(TFTPClient * client : this->closing)
+	{
+		delete client;
+	}
+
+	delete this->ring;
+	close(this->eventfd);
+	close(this->epollfd);
+}
+
+/**
+ * @brief Run loop in its own thread
+ * @param cpu core the thread is pinned to
+ */
+void TFTPEventLoop::start(unsigned int cpu)
+{
+	this->thread = new std::thread(&TFTPEventLoop::run, this);
+	TFTPServer::pin(this->thread, cpu);
+}
+
+/**
+ * @brief Hand new sessions over to the loop, can be called from any thread
+ * @param clients sessions
+ */
+void TFTPEventLoop::add(std::vector<TFTPClient *> & clients)
+{
+	this->active += clients.size();
+
+	this->queueLock.lock();
+	this->pending.insert(this->pending.end(), clients.begin(), clients.end());
+	this->queueLock.unlock();
+
+	this->wakeup();
+}
+
+/**
+ * @brief Continue session waiting for writer, can be called from any thread
+ * @param client session, ignored if loop no longer owns it
+ */
+void TFTPEventLoop::resume(TFTPClient * client)
+{
+	this->queueLock.lock();
+	this->resumed.push_back(client);
+	this->queueLock.unlock();
+
+	this->wakeup();
+}
+
+/**
+ * @brief Wait until every session is finished and stop the loop
+ */
+void TFTPEventLoop::drain()
+{
+	this->draining = true;
+	this->wakeup();
+
+	if(this->thread != nullptr)
+	{
+		this->thread->join();
+		delete this->thread;
+		this->thread = nullptr;
+	}
+}
+
+/**
+ * @brief Number of sessions owned by loop
+ * @return session count
+ */
+unsigned int TFTPEventLoop::size()
+{
+	return this->active;
+}
+
+/**
+ * @brief Does loop use io_uring?
+ * @return false if it runs on epoll
+ */
+bool TFTPEventLoop::hasRing()
+{
+	return this->ring != nullptr;
+}
+
+/**
+ * @brief Is loop finishing its sessions before it stops?
+ * @return true once drain was called
+ */
+bool TFTPEventLoop::isDraining()
+{
+	return this->draining;
+}
+
+/**
+ * @brief Interrupt epoll_wait
+ */
+void TFTPEventLoop::wakeup()
+{
+	uint64_t one = 1;
+
+	if(write(this->eventfd, &one, sizeof(one)) < 0)
+	{
+		// counter is already signaled
+	}
+}
+
+/**
+ * @brief Dispatch socket events and timeouts until drained
+ */
+void TFTPEventLoop::run()
+{
+	epoll_event events[MAX_EVENTS];
+	TFTPClient * client;
+	uint64_t counter;
+	int count;
+	int wait = TICK;
+	bool woken;
+
+	if(this->ring != nullptr)
+	{
+		this->runRing();
+		return;
+	}
+
+	while(true)
+	{
+		count = epoll_wait(this->epollfd, events, MAX_EVENTS, wait);
+		woken = false;
+
+		for(int i = 0; i < count; ++i)
+		{
+			if(events[i].data.ptr == nullptr)
+			{
+				if(read(this->eventfd, &counter, sizeof(counter)) < 0)
+				{
+					// spurious wakeup
+				}
+
+				this->accept();
+				woken = true;
+				continue;
+			}
+
+			client = (TFTPClient *) events[i].data.ptr;
+			client->receive();
+
+			if(client->isDone())
+			{
+				this->remove(client);
+			}
+		}
+
+		if(woken)
+		{
+			this->proceed(); // after batch, later events of it may belong to sessions removed here
+		}
+
+		wait = this->expire();
+
+		// queued requests are started by running loops, draining one takes them as its own
+		if(this->draining && this->active == 0 && !TFTPAdmission::instance().hasQueued())
+		{
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Dispatch completions and timeouts until drained, submitting and waiting is one syscall
+ */
+void TFTPEventLoop::runRing()
+{
+	io_uring_cqe cqe;
+	TFTPRing::operation * op;
+	TFTPClient * client;
+	uint64_t counter;
+	int wait = TICK;
+	bool woken;
+
+	this->pollWakeup();
+
+	while(true)
+	{
+		this->ring->submit(wait);
+		woken = false;
+
+		while(this->ring->reap(cqe))
+		{
+			op = (TFTPRing::operation *) cqe.user_data;
+
+			if(op == nullptr)
+			{
+				continue; // completion of cancel request
+			}
+
+			if(op->type == TFTPRing::WAKEUP)
+			{
+				if(read(this->eventfd, &counter, sizeof(counter)) < 0)
+				{
+					// spurious wakeup
+				}
+
+				this->accept();
+				this->pollWakeup();
+				woken = true;
+				continue;
+			}
+
+			client = (TFTPClient *) op->owner;
+			client->complete(op, cqe.res);
+
+			if(this->closing.count(client) != 0)
+			{
+				if(client->isIdle())
+				{
+					this->closing.erase(client);
+					delete client;
+					--this->active;
+				}
+			}
+			else if(client->isDone())
+			{
+				this->remove(client);
+			}
+		}
+
+		if(woken)
+		{
+			this->proceed();
+		}
+
+		wait = this->expire();
+
+		// queued requests are started by running loops, draining one takes them as its own
+		if(this->draining && this->active == 0 && !TFTPAdmission::instance().hasQueued())
+		{
+			break;
+		}
+	}
+}
+
+/**
+ * @brief Wait for wakeup of loop with one-shot poll of eventfd
+ */
+void TFTPEventLoop::pollWakeup()
+{
+	io_uring_sqe * sqe = this->ring->next();
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = this->eventfd;
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = (uint64_t) &this->waking;
+}
+
+/**
+ * @brief Continue sessions resumed by writer, called once events of batch are handled
+ */
+void TFTPEventLoop::proceed()
+{
+	std::vector<TFTPClient *> waiting;
+
+	this->queueLock.lock();
+	waiting.swap(this->resumed);
+	this->queueLock.unlock();
+
+	for(TFTPClient * client : waiting)
+	{
+		// session may have ended since writer resumed it
+		if(this->sessions.count(client) == 0)
+		{
+			continue;
+		}
+
+		client->resume();
+
+		if(client->isDone())
+		{
+			this->remove(client);
+		}
+	}
+}
+
+/**
+ * @brief Register pending sessions and send their first packet
+ */
+void TFTPEventLoop::accept()
+{
+	std::vector<TFTPClient *> clients;
+	epoll_event event;
+
+	this->queueLock.lock();
+	clients.swap(this->pending);
+	this->queueLock.unlock();
+
+	for(TFTPClient * client : clients)
+	{
+		this->sessions.insert(client);
+		client->setWheel(&this->wheel);
+		client->setLoop(this);
+
+		if(this->ring != nullptr)
+		{
+			client->setRing(this->ring);
+		}
+
+		client->start();
+
+		if(client->isDone())
+		{
+			this->remove(client);
+			continue;
+		}
+
+		if(this->ring != nullptr)
+		{
+			client->post();
+			continue;
+		}
+
+		event.events = EPOLLIN;
+		event.data.ptr = client;
+		epoll_ctl(this->epollfd, EPOLL_CTL_ADD, client->getSocket(), &event);
+	}
+}
+
+/**
+ * @brief Retransmit for every session whose timer expired, then start queued requests for which they made room
+ * @return milliseconds until nearest pending timer, at most TICK
+ */
+int TFTPEventLoop::expire()
+{
+	std::vector<void *> expired;
+	TFTPClient * client;
+
+	if(this->index == 0)
+	{
+		TFTPServer::report();
+	}
+
+	this->wheel.advance(TFTPTimerWheel::clock::now(), expired);
+
+	for(void * owner : expired)
+	{
+		client = (TFTPClient *) owner;
+		client->expire();
+
+		if(client->isDone())
+		{
+			this->remove(client);
+		}
+	}
+
+	this->admit();
+
+	return this->wheel.next(TICK);
+}
+
+/**
+ * @brief Start queued requests for which finished sessions made room, refuse those which waited too long,
+ * started requests are balanced among loops like new ones
+ */
+void TFTPEventLoop::admit()
+{
+	std::vector<TFTPClient *> ready;
+	std::vector<TFTPClient *> expired;
+
+	TFTPAdmission::instance().promote(ready, expired);
+
+	for(TFTPClient * client : expired)
+	{
+		client->reject();
+		delete client;
+	}
+
+	if(!ready.empty())
+	{
+		this->server->dispatch(ready, this->index);
+	}
+}
+
+/**
+ * @brief Unregister and destroy session, with io_uring once its operations complete
+ * @param client session
+ */
+void TFTPEventLoop::remove(TFTPClient * client)
+{
+	if(this->ring != nullptr)
+	{
+		// kernel may still use buffers of session
+		this->sessions.erase(client);
+		client->cancel();
+
+		if(client->isIdle())
+		{
+			delete client;
+			--this->active;
+		}
+		else
+		{
+			this->closing.insert(client);
+		}
+
+		return;
+	}
+
+	epoll_ctl(this->epollfd, EPOLL_CTL_DEL, client->getSocket(), NULL);
+	this->sessions.erase(client);
+	delete client;
+	--this->active;
+}
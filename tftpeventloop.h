@@ -0,0 +1,65 @@
+#ifndef H_TFTPEVENTLOOP
+#define H_TFTPEVENTLOOP
+
+#include "tftpexception.h"
+#include "tftptimerwheel.h"
+#include "tftpring.h"
+#include "tftpadmission.h"
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <unordered_set>
+
+class TFTPClient;
+class TFTPServer;
+
+class TFTPEventLoop
+{
+	int epollfd;
+	int eventfd;
+	std::thread * thread = nullptr;
+	std::mutex queueLock;
+	std::vector<TFTPClient *> pending;
+	std::vector<TFTPClient *> resumed; // writer caught up with their uploads
+	std::unordered_set<TFTPClient *> sessions;
+	std::atomic<unsigned int> active;
+	std::atomic<bool> draining;
+	TFTPTimerWheel wheel; // touched only by loop thread
+	TFTPRing * ring = nullptr; // completion based I/O instead of epoll
+	TFTPRing::operation waking; // poll of eventfd
+	TFTPServer * server; // dispatches sessions started from admission queue
+	unsigned int index; // position among loops of server
+	std::unordered_set<TFTPClient *> closing; // ring: finished, waiting for cancelled operations
+
+	public:
+		static const int MAX_EVENTS;
+		static const int TICK;
+
+		TFTPEventLoop(bool uring, TFTPServer * server, unsigned int index);
+		~TFTPEventLoop();
+		void start(unsigned int cpu);
+		void add(std::vector<TFTPClient *> & clients);
+		void resume(TFTPClient * client);
+		void drain();
+		unsigned int size();
+		bool hasRing();
+		bool isDraining();
+
+	private:
+		void run();
+		void runRing();
+		void pollWakeup();
+		void wakeup();
+		void accept();
+		void proceed();
+		int expire();
+		void admit();
+		void remove(TFTPClient * client);
+};
+
+#endif
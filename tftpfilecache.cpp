@@ -0,0 +1,231 @@
+#include "tftpfilecache.h"
+
+TFTPFileCache::TFTPFileCache() : hits(0), misses(0), loads(0), evictions(0)
+{
+
+}
+
+/**
+ * @brief Process wide cache shared by all sessions
+ * @return cache
+ */
+TFTPFileCache & TFTPFileCache::instance()
+{
+	static TFTPFileCache cache;
+	return cache;
+}
+
+/**
+ * @brief Start loader thread
+ */
+void TFTPFileCache::start()
+{
+	this->thread = new std::thread(&TFTPFileCache::run, this);
+}
+
+/**
+ * @brief Stop loader thread, queued loads are dropped
+ */
+void TFTPFileCache::stop()
+{
+	if(this->thread == nullptr)
+	{
+		return;
+	}
+
+	this->lock.lock();
+	this->stopping = true;
+	this->lock.unlock();
+	this->ready.notify_one();
+
+	this->thread->join();
+	delete this->thread;
+	this->thread = nullptr;
+}
+
+/**
+ * @brief Set maximal amount of cached bytes, 0 disables cache
+ * @param bytes capacity
+ */
+void TFTPFileCache::setCapacity(std::size_t bytes)
+{
+	this->lock.lock();
+	this->capacity = bytes;
+	this->evict();
+	this->lock.unlock();
+}
+
+/**
+ * @brief Get content of file, on miss it is loaded by loader thread while session reads descriptor
+ * @param path path to file
+ * @param source file opened by session, cached content must match its state
+ * @return shared content or nullptr if file is not cached (yet)
+ */
+TFTPFileCache::content TFTPFileCache::get(const std::string & path, const TFTPDescriptorCache::descriptor & source)
+{
+	const struct stat & info = source->info;
+	std::unordered_map<std::string, entryList::iterator>::iterator it;
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	if(!S_ISREG(info.st_mode) || (std::size_t) info.st_size > this->capacity / 2)
+	{
+		return nullptr; // too big, would flush whole cache
+	}
+
+	it = this->index.find(path);
+
+	if(it != this->index.end())
+	{
+		if(this->same(*it->second, info))
+		{
+			this->lru.splice(this->lru.begin(), this->lru, it->second);
+			++this->hits;
+			return it->second->data;
+		}
+
+		// file was changed since it was cached
+		this->used -= it->second->data->size();
+		this->lru.erase(it->second);
+		this->index.erase(it);
+	}
+
+	++this->misses;
+
+	// concurrent misses of the same file wait for single load
+	if(this->thread != nullptr && this->loading.insert(path).second)
+	{
+		this->queue.push_back(request{path, source});
+		this->ready.notify_one();
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief Drop file from cache, sessions which hold its content keep their copy
+ * @param path path to file
+ */
+void TFTPFileCache::invalidate(const std::string & path)
+{
+	std::unordered_map<std::string, entryList::iterator>::iterator it;
+
+	this->lock.lock();
+	it = this->index.find(path);
+
+	if(it != this->index.end())
+	{
+		this->used -= it->second->data->size();
+		this->lru.erase(it->second);
+		this->index.erase(it);
+	}
+
+	this->loading.erase(path); // content being loaded may be stale, it is dropped
+	this->lock.unlock();
+}
+
+/**
+ * @brief Print cache statistics
+ */
+void TFTPFileCache::print()
+{
+	std::cout << "File cache: " << this->hits << " hits, " << this->misses << " misses, " << this->loads << " loads, " << this->evictions << " evictions" << std::endl;
+}
+
+/**
+ * @brief Cached entry still describes file on disk?
+ * @param item cached entry
+ * @param info current state of file
+ * @return true if file was not replaced or modified
+ */
+bool TFTPFileCache::same(const entry & item, const struct stat & info)
+{
+	return item.dev == info.st_dev && item.ino == info.st_ino
+		&& item.mtime.tv_sec == info.st_mtim.tv_sec && item.mtime.tv_nsec == info.st_mtim.tv_nsec
+		&& item.data->size() == (std::size_t) info.st_size;
+}
+
+/**
+ * @brief Read whole file to memory
+ * @param fd open file
+ * @param size size of file
+ * @return content or nullptr on error
+ */
+TFTPFileCache::content TFTPFileCache::load(int fd, std::size_t size)
+{
+	std::vector<char> * data = new std::vector<char>(size);
+	std::size_t offset = 0;
+	ssize_t result;
+
+	while(offset < size)
+	{
+		result = pread(fd, data->data() + offset, size - offset, offset);
+
+		if(result <= 0)
+		{
+			delete data;
+			return nullptr;
+		}
+
+		offset += result;
+	}
+
+	return content(data);
+}
+
+/**
+ * @brief Loader thread, reads missed files off event loops and adds them to cache
+ */
+void TFTPFileCache::run()
+{
+	std::unique_lock<std::mutex> guard(this->lock);
+	request item;
+	content data;
+
+	while(true)
+	{
+		this->ready.wait(guard, [this]{ return this->stopping || !this->queue.empty(); });
+
+		if(this->stopping)
+		{
+			break;
+		}
+
+		item = this->queue.front();
+		this->queue.pop_front();
+
+		guard.unlock();
+		data = this->load(item.source->fd, item.source->info.st_size);
+		guard.lock();
+
+		// not invalidated meanwhile
+		if(this->loading.erase(item.path) != 0 && data != nullptr && this->index.find(item.path) == this->index.end())
+		{
+			const struct stat & info = item.source->info;
+
+			this->lru.push_front(entry{item.path, info.st_dev, info.st_ino, info.st_mtim, data});
+			this->index[item.path] = this->lru.begin();
+			this->used += data->size();
+			++this->loads;
+			this->evict();
+		}
+
+		item.source.reset();
+		data.reset();
+	}
+
+	this->queue.clear();
+}
+
+/**
+ * @brief Remove least recently used entries until cache fits its capacity, lock must be held
+ */
+void TFTPFileCache::evict()
+{
+	while(this->used > this->capacity && !this->lru.empty())
+	{
+		this->used -= this->lru.back().data->size();
+		this->index.erase(this->lru.back().path);
+		this->lru.pop_back();
+		++this->evictions;
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef H_TFTPFILECACHE
+#define H_TFTPFILECACHE
+
+#include "tftpdescriptorcache.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+
+class TFTPFileCache
+{
+	public:
+		using content = std::shared_ptr<const std::vector<char>>;
+
+	private:
+		struct entry
+		{
+			std::string path;
+			dev_t dev;
+			ino_t ino;
+			timespec mtime;
+			content data;
+		};
+
+		// file read by loader thread, sessions meanwhile read it from descriptor
+		struct request
+		{
+			std::string path;
+			TFTPDescriptorCache::descriptor source; // keeps descriptor open until loaded
+		};
+
+		using entryList = std::list<entry>;
+
+		std::mutex lock;
+		entryList lru; // most recently used first
+		std::unordered_map<std::string, entryList::iterator> index;
+		std::size_t used = 0;
+		std::size_t capacity = 0;
+
+		std::unordered_set<std::string> loading; // in flight, one load per file
+		std::deque<request> queue;
+		std::condition_variable ready;
+		std::thread * thread = nullptr;
+		bool stopping = false;
+
+		std::atomic<unsigned long> hits;
+		std::atomic<unsigned long> misses;
+		std::atomic<unsigned long> loads;
+		std::atomic<unsigned long> evictions;
+
+		TFTPFileCache();
+		bool same(const entry & item, const struct stat & info);
+		content load(int fd, std::size_t size);
+		void run();
+		void evict();
+
+	public:
+		static TFTPFileCache & instance();
+
+		void start();
+		void stop();
+		void setCapacity(std::size_t bytes);
+		content get(const std::string & path, const TFTPDescriptorCache::descriptor & source);
+		void invalidate(const std::string & path);
+		void print();
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "tftpmulticast.h"
+
+std::mutex TFTPMulticast::lock;
+std::map<std::string, TFTPMulticast *> TFTPMulticast::groups;
+std::string TFTPMulticast::address;
+unsigned short TFTPMulticast::port = 0;
+bool TFTPMulticast::ipv6 = false;
+
+/**
+ * @brief Set group address, every group gets own port starting from port
+ * @param address multicast address
+ * @param port first port
+ * @param ipv6 ip version of address
+ */
+void TFTPMulticast::configure(const std::string & address, unsigned short port, bool ipv6)
+{
+	TFTPMulticast::address = address;
+	TFTPMulticast::port = port;
+	TFTPMulticast::ipv6 = ipv6;
+}
+
+/**
+ * @brief Can client of given ip version use multicast?
+ * @param ipv6 ip version of client
+ * @return true if multicast address is configured for this version
+ */
+bool TFTPMulticast::enabled(bool ipv6)
+{
+	return !TFTPMulticast::address.empty() && TFTPMulticast::ipv6 == ipv6;
+}
+
+/**
+ * @brief Find running transfer, lock must be held
+ * @param key file and transfer parameters
+ * @return group or nullptr
+ */
+TFTPMulticast * TFTPMulticast::find(const std::string & key)
+{
+	std::map<std::string, TFTPMulticast *>::iterator it = TFTPMulticast::groups.find(key);
+
+	return it == TFTPMulticast::groups.end() ? nullptr : it->second;
+}
+
+/**
+ * @brief Register new transfer on first free port, lock must be held
+ * @param key file and transfer parameters
+ * @param sck socket of owner session, DATA are sent from it
+ * @param master first client
+ * @param socklen size of master address
+ * @return group
+ */
+TFTPMulticast * TFTPMulticast::create(const std::string & key, int sck, const sockaddr * master, socklen_t socklen)
+{
+	unsigned short port = TFTPMulticast::port;
+	bool used = true;
+	TFTPMulticast * group;
+
+	while(used)
+	{
+		used = false;
+
+		for(std::map<std::string, TFTPMulticast *>::iterator it = TFTPMulticast::groups.begin(); it != TFTPMulticast::groups.end(); ++it)
+		{
+			if(it->second->targetPort == port)
+			{
+				used = true;
+				++port;
+				break;
+			}
+		}
+	}
+
+	group = new TFTPMulticast(key, sck, port);
+	group->join(master, socklen);
+	TFTPMulticast::groups[key] = group;
+
+	return group;
+}
+
+/**
+ * @brief Unregister and destroy transfer, lock must not be held
+ * @param group transfer
+ */
+void TFTPMulticast::release(TFTPMulticast * group)
+{
+	TFTPMulticast::lock.lock();
+
+	if(TFTPMulticast::find(group->key) == group)
+	{
+		TFTPMulticast::groups.erase(group->key);
+	}
+
+	TFTPMulticast::lock.unlock();
+
+	delete group;
+}
+
+/**
+ * @brief Prepare group address
+ * @param key file and transfer parameters
+ * @param sck socket of owner session
+ * @param port group port
+ */
+TFTPMulticast::TFTPMulticast(const std::string & key, int sck, unsigned short port)
+{
+	sockaddr_in local;
+	socklen_t socklen = sizeof(local);
+
+	this->key = key;
+	this->sck = sck;
+	this->targetPort = port;
+	memset(&this->target, 0, sizeof(this->target));
+
+	// send group traffic through interface of listening address
+	if(!TFTPMulticast::ipv6 && getsockname(sck, (sockaddr *) &local, &socklen) == 0 && local.sin_addr.s_addr != INADDR_ANY)
+	{
+		setsockopt(sck, IPPROTO_IP, IP_MULTICAST_IF, &local.sin_addr, sizeof(local.sin_addr));
+	}
+
+	if(TFTPMulticast::ipv6)
+	{
+		sockaddr_in6 * inaddr = (sockaddr_in6 *) &this->target;
+		inaddr->sin6_family = AF_INET6;
+		inaddr->sin6_port = htons(port);
+		inet_pton(AF_INET6, TFTPMulticast::address.c_str(), &inaddr->sin6_addr);
+		this->targetLength = sizeof(sockaddr_in6);
+	}
+	else
+	{
+		sockaddr_in * inaddr = (sockaddr_in *) &this->target;
+		inaddr->sin_family = AF_INET;
+		inaddr->sin_port = htons(port);
+		inet_pton(AF_INET, TFTPMulticast::address.c_str(), &inaddr->sin_addr);
+		this->targetLength = sizeof(sockaddr_in);
+	}
+}
+
+/**
+ * @brief Add client to the end of master queue once, lock must be held
+ * @param inaddr client address
+ * @param socklen size of inaddr
+ */
+void TFTPMulticast::join(const sockaddr * inaddr, socklen_t socklen)
+{
+	member client;
+
+	// retransmitted RRQ of member whose OACK was lost, its session is already gone
+	for(const member & known : this->members)
+	{
+		if(TFTPMulticast::same(known, inaddr))
+		{
+			return;
+		}
+	}
+
+	memcpy(&client.addr, inaddr, socklen);
+	client.socklen = socklen;
+	this->members.push_back(client);
+}
+
+/**
+ * @brief Is member the client (address and port)?
+ * @param known member
+ * @param inaddr client address
+ * @return true for the same client
+ */
+bool TFTPMulticast::same(const member & known, const sockaddr * inaddr)
+{
+	const sockaddr * addr = (const sockaddr *) &known.addr;
+
+	if(addr->sa_family != inaddr->sa_family)
+	{
+		return false;
+	}
+
+	if(addr->sa_family == AF_INET6)
+	{
+		return ((const sockaddr_in6 *) addr)->sin6_port == ((const sockaddr_in6 *) inaddr)->sin6_port
+			&& memcmp(&((const sockaddr_in6 *) addr)->sin6_addr, &((const sockaddr_in6 *) inaddr)->sin6_addr, sizeof(in6_addr)) == 0;
+	}
+
+	return ((const sockaddr_in *) addr)->sin_port == ((const sockaddr_in *) inaddr)->sin_port
+		&& ((const sockaddr_in *) addr)->sin_addr.s_addr == ((const sockaddr_in *) inaddr)->sin_addr.s_addr;
+}
+
+/**
+ * @brief Master finished, promote next client; when there is none, group stops accepting clients
+ * @return false if no client is left
+ */
+bool TFTPMulticast::next()
+{
+	std::lock_guard<std::mutex> guard(TFTPMulticast::lock);
+
+	this->members.pop_front();
+
+	if(this->members.empty())
+	{
+		TFTPMulticast::groups.erase(this->key);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Current master client
+ * @return master
+ */
+TFTPMulticast::member TFTPMulticast::master()
+{
+	std::lock_guard<std::mutex> guard(TFTPMulticast::lock);
+
+	return this->members.front();
+}
+
+/**
+ * @brief Value of multicast option for OACK
+ * @param master is client master?
+ * @return addr,port,mc
+ */
+std::string TFTPMulticast::option(bool master)
+{
+	return TFTPMulticast::address + "," + std::to_string(this->targetPort) + "," + (master ? "1" : "0");
+}
+
+/**
+ * @brief Socket which DATA are sent from and ACKs received on
+ * @return socket descriptor
+ */
+int TFTPMulticast::getSocket()
+{
+	return this->sck;
+}
+
+/**
+ * @brief Group address
+ * @return sockaddr
+ */
+const sockaddr * TFTPMulticast::getTarget()
+{
+	return (const sockaddr *) &this->target;
+}
+
+/**
+ * @brief Size of group address
+ * @return size
+ */
+socklen_t TFTPMulticast::getTargetLength()
+{
+	return this->targetLength;
+}
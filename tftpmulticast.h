@@ -0,0 +1,57 @@
+#ifndef H_TFTPMULTICAST
+#define H_TFTPMULTICAST
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <map>
+#include <mutex>
+
+class TFTPMulticast
+{
+	public:
+		struct member
+		{
+			sockaddr_storage addr;
+			socklen_t socklen;
+		};
+
+		static std::mutex lock; // guards every group and registry
+
+	private:
+		static std::map<std::string, TFTPMulticast *> groups;
+		static std::string address;
+		static unsigned short port;
+		static bool ipv6;
+
+		std::string key;
+		int sck;
+		sockaddr_storage target;
+		socklen_t targetLength;
+		unsigned short targetPort;
+		std::deque<member> members; // front is master client, owner session serves them all
+
+	public:
+		static void configure(const std::string & address, unsigned short port, bool ipv6);
+		static bool enabled(bool ipv6);
+		static TFTPMulticast * find(const std::string & key);
+		static TFTPMulticast * create(const std::string & key, int sck, const sockaddr * master, socklen_t socklen);
+		static void release(TFTPMulticast * group);
+
+		void join(const sockaddr * inaddr, socklen_t socklen);
+		bool next();
+		member master();
+		std::string option(bool master);
+		int getSocket();
+		const sockaddr * getTarget();
+		socklen_t getTargetLength();
+
+	private:
+		TFTPMulticast(const std::string & key, int sck, unsigned short port);
+		static bool same(const member & known, const sockaddr * inaddr);
+};
+
+#endif
@@ -0,0 +1,365 @@
+#include "tftpnetascii.h"
+#include "tftpnetasciicache.h"
+
+/**
+ * @brief Encoder of RRQ
+ * @param source source file, read only by pread so it can be shared
+ * @param path path to source file, key of cached index
+ */
+TFTPNetascii::TFTPNetascii(const TFTPDescriptorCache::descriptor & source, const std::string & path)
+{
+	this->fd = source->fd;
+	this->path = path;
+	this->source = source;
+}
+
+/**
+ * @brief Decoder of WRQ
+ * @param fd destination file, not read by decoder
+ */
+TFTPNetascii::TFTPNetascii(int fd)
+{
+	this->fd = fd;
+}
+
+/**
+ * @brief Fill block with netascii data, LF becomes CR LF and CR becomes CR NUL
+ * @param out block
+ * @param length size of block
+ * @return number of bytes, less than length only at the end of file
+ */
+int TFTPNetascii::encode(char * out, int length)
+{
+	const char * begin;
+	const char * hit;
+	int limit;
+	int n = 0;
+	ssize_t result;
+
+	if(this->input.empty())
+	{
+		this->input.resize(INPUT_SIZE);
+	}
+
+	if(this->offsets == nullptr && this->produced >= (long long) this->marks.size() * STRIDE)
+	{
+		this->marks.push_back(passed{this->produced, this->current});
+	}
+
+	if(this->current.carry >= 0 && n < length)
+	{
+		out[n++] = this->current.carry;
+		this->current.carry = -1;
+	}
+
+	while(n < length)
+	{
+		if(this->inputPos == this->inputEnd)
+		{
+			result = pread(this->fd, this->input.data(), this->input.size(), this->current.offset);
+
+			if(result <= 0)
+			{
+				break;
+			}
+
+			this->inputOffset = this->current.offset;
+			this->inputPos = 0;
+			this->inputEnd = result;
+		}
+
+		// copy run of ordinary bytes at once
+		begin = this->input.data() + this->inputPos;
+		limit = std::min(this->inputEnd - this->inputPos, length - n);
+		hit = TFTPNetascii::scan(begin, begin + limit, true);
+
+		memcpy(out + n, begin, hit - begin);
+		n += hit - begin;
+		this->inputPos += hit - begin;
+
+		if(hit == begin + limit)
+		{
+			this->current.offset = this->inputOffset + this->inputPos;
+			continue;
+		}
+
+		++this->inputPos;
+		this->current.offset = this->inputOffset + this->inputPos;
+		out[n++] = '\r';
+
+		if(n < length)
+		{
+			out[n++] = *hit == '\r' ? '\0' : '\n';
+		}
+		else
+		{
+			this->current.carry = *hit == '\r' ? '\0' : '\n'; // sequence split between blocks
+		}
+	}
+
+	this->produced += n;
+
+	return n;
+}
+
+/**
+ * @brief Continue from offset in converted file (retransmission), conversion starts at nearest mark
+ * of index or, until index is built, at nearest position this transfer passed
+ * @param offset offset in converted file, not beyond current position
+ */
+void TFTPNetascii::seek(long long offset)
+{
+	std::vector<char> skipped;
+	std::size_t mark;
+	long long skip;
+
+	this->load();
+
+	if(this->offsets != nullptr)
+	{
+		mark = std::min<std::size_t>(offset / STRIDE, this->offsets->marks.size() - 1);
+		this->restore(this->offsets->marks[mark]);
+		this->produced = (long long) mark * STRIDE;
+	}
+	else
+	{
+		mark = std::min<std::size_t>(offset / STRIDE, this->marks.size() - 1);
+
+		while(mark > 0 && this->marks[mark].out > offset)
+		{
+			--mark;
+		}
+
+		this->restore(this->marks[mark].where);
+		this->produced = this->marks[mark].out;
+	}
+
+	skip = offset - this->produced;
+
+	if(skip > 0)
+	{
+		skipped.resize(skip);
+		this->encode(skipped.data(), skip); // at most STRIDE bytes are converted again
+	}
+}
+
+/**
+ * @brief Size of whole file in netascii
+ * @return size in bytes or -1 while index is built
+ */
+long long TFTPNetascii::length()
+{
+	this->load();
+
+	return this->offsets != nullptr ? this->offsets->size : -1;
+}
+
+/**
+ * @brief Ask kernel to read source file ahead of conversion, next pread does not wait for disk
+ * @param length number of bytes following current position
+ */
+void TFTPNetascii::prefetch(long long length)
+{
+	posix_fadvise(this->fd, this->current.offset, length, POSIX_FADV_WILLNEED);
+}
+
+/**
+ * @brief Scan file once, remember its converted size and position of every STRIDE converted bytes
+ * @param fd source file
+ * @return index
+ */
+TFTPNetascii::index TFTPNetascii::build(int fd)
+{
+	layout * result = new layout;
+	std::vector<char> chunk(INPUT_SIZE);
+	const char * begin;
+	const char * end;
+	const char * hit;
+	long long offset = 0; // source
+	long long out = 0; // converted
+	long long next = STRIDE;
+	ssize_t length;
+
+	result->marks.push_back(position());
+
+	while((length = pread(fd, chunk.data(), chunk.size(), offset)) > 0)
+	{
+		begin = chunk.data();
+		end = begin + length;
+
+		while(begin < end)
+		{
+			hit = TFTPNetascii::scan(begin, end, true);
+
+			for(; next < out + (hit - begin); next += STRIDE)
+			{
+				result->marks.push_back(position(offset + (next - out), -1));
+			}
+
+			offset += hit - begin;
+			out += hit - begin;
+			begin = hit;
+
+			if(hit == end)
+			{
+				break;
+			}
+
+			if(next == out)
+			{
+				result->marks.push_back(position(offset, -1));
+				next += STRIDE;
+			}
+			else if(next == out + 1)
+			{
+				result->marks.push_back(position(offset + 1, *hit == '\r' ? '\0' : '\n'));
+				next += STRIDE;
+			}
+
+			++offset;
+			out += 2;
+			++begin;
+		}
+	}
+
+	result->size = out;
+
+	return index(result);
+}
+
+/**
+ * @brief Get index of source file from cache, on miss it is built off loop and looked up again later
+ */
+void TFTPNetascii::load()
+{
+	if(this->offsets == nullptr)
+	{
+		this->offsets = TFTPNetasciiCache::instance().get(this->path, this->source);
+	}
+}
+
+/**
+ * @brief Continue from position, buffered input is reused
+ * @param where position
+ */
+void TFTPNetascii::restore(position where)
+{
+	this->current = where;
+
+	if(where.offset >= this->inputOffset && where.offset <= this->inputOffset + this->inputEnd)
+	{
+		this->inputPos = where.offset - this->inputOffset;
+	}
+	else
+	{
+		this->inputPos = this->inputEnd = 0;
+	}
+}
+
+/**
+ * @brief Write netascii data in machine format, CR LF becomes LF and CR NUL becomes CR
+ * @param in payload of DATA block
+ * @param length size of payload
+ * @param out destination file
+ * @return false if write failed
+ */
+bool TFTPNetascii::decode(const char * in, int length, std::FILE * out)
+{
+	const char * end = in + length;
+	const char * hit;
+
+	while(in < end)
+	{
+		if(this->cr)
+		{
+			// CR followed by anything else is kept as it is
+			this->cr = false;
+
+			if(*in != '\n' && *in != '\0' && fputc('\r', out) == EOF)
+			{
+				return false;
+			}
+
+			if(*in == '\0')
+			{
+				if(fputc('\r', out) == EOF)
+				{
+					return false;
+				}
+
+				++in;
+				continue;
+			}
+		}
+
+		hit = TFTPNetascii::scan(in, end, false);
+
+		if(fwrite(in, 1, hit - in, out) != (std::size_t) (hit - in))
+		{
+			return false;
+		}
+
+		if(hit < end)
+		{
+			this->cr = true; // pair may continue in next block
+			++hit;
+		}
+
+		in = hit;
+	}
+
+	return true;
+}
+
+/**
+ * @brief End of transfer, write CR which was not followed by anything
+ * @param out destination file
+ * @return false if write failed
+ */
+bool TFTPNetascii::flush(std::FILE * out)
+{
+	if(this->cr)
+	{
+		this->cr = false;
+		return fputc('\r', out) != EOF;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Find first CR (or LF), 16 bytes per step with SSE2
+ * @param begin start of data
+ * @param end end of data
+ * @param lf look for LF too
+ * @return pointer to found byte or end
+ */
+const char * TFTPNetascii::scan(const char * begin, const char * end, bool lf)
+{
+#ifdef __SSE2__
+	const __m128i crs = _mm_set1_epi8('\r');
+	const __m128i lfs = _mm_set1_epi8(lf ? '\n' : '\r');
+	__m128i chunk;
+	int mask;
+
+	while(end - begin >= 16)
+	{
+		chunk = _mm_loadu_si128((const __m128i *) begin);
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, crs), _mm_cmpeq_epi8(chunk, lfs)));
+
+		if(mask != 0)
+		{
+			return begin + __builtin_ctz(mask);
+		}
+
+		begin += 16;
+	}
+#endif
+
+	while(begin < end && *begin != '\r' && (!lf || *begin != '\n'))
+	{
+		++begin;
+	}
+
+	return begin;
+}
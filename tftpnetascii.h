@@ -0,0 +1,79 @@
+#ifndef H_TFTPNETASCII
+#define H_TFTPNETASCII
+
+#include "tftpdescriptorcache.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+class TFTPNetascii
+{
+	public:
+		// place in converted stream, enough to regenerate any block
+		struct position
+		{
+			long long offset; // next unread byte of source file
+			int carry; // second byte of CR NUL / CR LF which did not fit to previous block
+
+			position(long long offset = 0, int carry = -1) : offset(offset), carry(carry) {}
+		};
+
+		// converted size and positions of every STRIDE bytes of converted file
+		struct layout
+		{
+			long long size = 0;
+			std::vector<position> marks;
+		};
+
+		using index = std::shared_ptr<const layout>;
+
+		static const int INPUT_SIZE = 65536;
+		static const int STRIDE = 8192;
+
+	private:
+		// position reached by this transfer, converted offset is at most one block past mark
+		struct passed
+		{
+			long long out;
+			position where;
+		};
+
+		int fd;
+		std::string path;
+		TFTPDescriptorCache::descriptor source; // RRQ: keeps file open, cache builds index from it
+		index offsets; // loaded on first use
+		std::vector<passed> marks; // rollback while index is not built, one per STRIDE converted bytes
+		long long produced = 0; // converted offset of current position
+		std::vector<char> input;
+		long long inputOffset = 0; // source offset of input[0]
+		int inputPos = 0;
+		int inputEnd = 0;
+		position current;
+		bool cr = false; // decoder: last byte was CR
+
+		static const char * scan(const char * begin, const char * end, bool lf);
+		void restore(position where);
+		void load();
+
+	public:
+		static index build(int fd);
+
+		TFTPNetascii(const TFTPDescriptorCache::descriptor & source, const std::string & path);
+		TFTPNetascii(int fd);
+		int encode(char * out, int length);
+		void seek(long long offset);
+		long long length();
+		void prefetch(long long length);
+		bool decode(const char * in, int length, std::FILE * out);
+		bool flush(std::FILE * out);
+};
+
+#endif
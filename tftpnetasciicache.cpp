@@ -0,0 +1,184 @@
+#include "tftpnetasciicache.h"
+
+const std::size_t TFTPNetasciiCache::MAX_ENTRIES = 1024;
+
+TFTPNetasciiCache::TFTPNetasciiCache() : hits(0), misses(0), builds(0)
+{
+
+}
+
+/**
+ * @brief Process wide cache of netascii indexes shared by all sessions
+ * @return cache
+ */
+TFTPNetasciiCache & TFTPNetasciiCache::instance()
+{
+	static TFTPNetasciiCache cache;
+	return cache;
+}
+
+/**
+ * @brief Start builder thread
+ */
+void TFTPNetasciiCache::start()
+{
+	this->thread = new std::thread(&TFTPNetasciiCache::run, this);
+}
+
+/**
+ * @brief Stop builder thread, queued scans are dropped
+ */
+void TFTPNetasciiCache::stop()
+{
+	if(this->thread == nullptr)
+	{
+		return;
+	}
+
+	this->lock.lock();
+	this->stopping = true;
+	this->lock.unlock();
+	this->ready.notify_one();
+
+	this->thread->join();
+	delete this->thread;
+	this->thread = nullptr;
+}
+
+/**
+ * @brief Get netascii index of file, on miss it is built by builder thread while session converts without it
+ * @param path path to file
+ * @param source file opened by session, index must describe this very file
+ * @return index or nullptr if file is not indexed (yet)
+ */
+TFTPNetascii::index TFTPNetasciiCache::get(const std::string & path, const TFTPDescriptorCache::descriptor & source)
+{
+	struct stat info;
+	std::unordered_map<std::string, entryList::iterator>::iterator it;
+
+	if(fstat(source->fd, &info) != 0)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	it = this->index.find(path);
+
+	if(it != this->index.end())
+	{
+		if(this->same(*it->second, info))
+		{
+			this->lru.splice(this->lru.begin(), this->lru, it->second);
+			++this->hits;
+			return it->second->offsets;
+		}
+
+		// file was changed since it was indexed
+		this->lru.erase(it->second);
+		this->index.erase(it);
+	}
+
+	// concurrent misses of the same file wait for single scan, sessions looking again meanwhile are not counted
+	if(this->thread != nullptr && this->building.insert(path).second)
+	{
+		++this->misses;
+		this->queue.push_back(request{path, source});
+		this->ready.notify_one();
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief Drop index of file
+ * @param path path to file
+ */
+void TFTPNetasciiCache::invalidate(const std::string & path)
+{
+	std::unordered_map<std::string, entryList::iterator>::iterator it;
+
+	this->lock.lock();
+	it = this->index.find(path);
+
+	if(it != this->index.end())
+	{
+		this->lru.erase(it->second);
+		this->index.erase(it);
+	}
+
+	this->building.erase(path); // index being built may be stale, it is dropped
+	this->lock.unlock();
+}
+
+/**
+ * @brief Print cache statistics
+ */
+void TFTPNetasciiCache::print()
+{
+	std::cout << "Netascii index: " << this->hits << " hits, " << this->misses << " misses, " << this->builds << " builds" << std::endl;
+}
+
+/**
+ * @brief Builder thread, scans missed files off event loops and adds their indexes to cache
+ */
+void TFTPNetasciiCache::run()
+{
+	std::unique_lock<std::mutex> guard(this->lock);
+	request item;
+	struct stat info;
+	TFTPNetascii::index offsets;
+
+	while(true)
+	{
+		this->ready.wait(guard, [this]{ return this->stopping || !this->queue.empty(); });
+
+		if(this->stopping)
+		{
+			break;
+		}
+
+		item = this->queue.front();
+		this->queue.pop_front();
+
+		guard.unlock();
+
+		if(fstat(item.source->fd, &info) == 0)
+		{
+			offsets = TFTPNetascii::build(item.source->fd);
+		}
+
+		guard.lock();
+
+		// not invalidated meanwhile
+		if(this->building.erase(item.path) != 0 && offsets != nullptr && this->index.find(item.path) == this->index.end())
+		{
+			this->lru.push_front(entry{item.path, info.st_dev, info.st_ino, info.st_mtim, info.st_size, offsets});
+			this->index[item.path] = this->lru.begin();
+			++this->builds;
+
+			while(this->lru.size() > MAX_ENTRIES)
+			{
+				this->index.erase(this->lru.back().path);
+				this->lru.pop_back();
+			}
+		}
+
+		item.source.reset();
+		offsets.reset();
+	}
+
+	this->queue.clear();
+}
+
+/**
+ * @brief Cached entry still describes file on disk?
+ * @param item cached entry
+ * @param info current state of file
+ * @return true if file was not replaced or modified
+ */
+bool TFTPNetasciiCache::same(const entry & item, const struct stat & info)
+{
+	return item.dev == info.st_dev && item.ino == info.st_ino
+		&& item.mtime.tv_sec == info.st_mtim.tv_sec && item.mtime.tv_nsec == info.st_mtim.tv_nsec
+		&& item.size == info.st_size;
+}
@@ -0,0 +1,70 @@
+#ifndef H_TFTPNETASCIICACHE
+#define H_TFTPNETASCIICACHE
+
+#include "tftpnetascii.h"
+#include "tftpdescriptorcache.h"
+#include <sys/stat.h>
+#include <string>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+
+class TFTPNetasciiCache
+{
+	private:
+		struct entry
+		{
+			std::string path;
+			dev_t dev;
+			ino_t ino;
+			timespec mtime;
+			off_t size;
+			TFTPNetascii::index offsets;
+		};
+
+		// file indexed by builder thread, sessions meanwhile convert it without index
+		struct request
+		{
+			std::string path;
+			TFTPDescriptorCache::descriptor source; // keeps descriptor open until indexed
+		};
+
+		using entryList = std::list<entry>;
+
+		static const std::size_t MAX_ENTRIES;
+
+		std::mutex lock;
+		entryList lru; // most recently used first
+		std::unordered_map<std::string, entryList::iterator> index;
+
+		std::unordered_set<std::string> building; // in flight, one scan per file
+		std::deque<request> queue;
+		std::condition_variable ready;
+		std::thread * thread = nullptr;
+		bool stopping = false;
+
+		std::atomic<unsigned long> hits;
+		std::atomic<unsigned long> misses;
+		std::atomic<unsigned long> builds;
+
+		TFTPNetasciiCache();
+		bool same(const entry & item, const struct stat & info);
+		void run();
+
+	public:
+		static TFTPNetasciiCache & instance();
+
+		void start();
+		void stop();
+		TFTPNetascii::index get(const std::string & path, const TFTPDescriptorCache::descriptor & source);
+		void invalidate(const std::string & path);
+		void print();
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "tftprequest.h"
+
+/**
+ * @brief Case-insensitive comparison (mode and option names, RFC 1350, 2347)
+ * @param literal lowercase letters
+ * @return true if view holds the same text
+ */
+bool TFTPRequest::view::equals(const char * literal) const
+{
+	std::size_t i = 0;
+
+	for(; i < this->length; ++i)
+	{
+		if(literal[i] == '\0' || (this->data[i] | 0x20) != literal[i])
+		{
+			return false;
+		}
+	}
+
+	return literal[i] == '\0';
+}
+
+/**
+ * @brief Copy of viewed bytes
+ * @return string
+ */
+std::string TFTPRequest::view::str() const
+{
+	return std::string(this->data, this->length);
+}
+
+/**
+ * @brief Split RRQ/WRQ datagram in single pass, fields point into datagram
+ * @param data datagram, must outlive request
+ * @param length size of datagram
+ * @throws TFTPProtocolException ILLEGAL if filename or mode is missing, OPTION if options are malformed
+ */
+TFTPRequest::TFTPRequest(const char * data, std::size_t length)
+{
+	const char * position = data + 2;
+	const char * end = data + length;
+
+	if(length < 2)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+	}
+
+	this->opcode = ((unsigned char) data[0]) << 8 | (unsigned char) data[1];
+	this->filename = TFTPRequest::field(position, end);
+	this->mode = TFTPRequest::field(position, end);
+
+	if(this->filename.data == nullptr || this->filename.length == 0 || this->mode.data == nullptr)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::ILLEGAL);
+	}
+
+	while(position < end)
+	{
+		if(this->count == MAX_OPTIONS)
+		{
+			throw TFTPProtocolException(TFTPProtocolException::OPTION);
+		}
+
+		this->options[this->count].key = TFTPRequest::field(position, end);
+		this->options[this->count].value = TFTPRequest::field(position, end);
+
+		// option without value or not terminated
+		if(this->options[this->count].value.data == nullptr)
+		{
+			throw TFTPProtocolException(TFTPProtocolException::OPTION);
+		}
+
+		++this->count;
+	}
+}
+
+/**
+ * @brief Operation of request
+ * @return RRQ or WRQ, other values are not checked
+ */
+unsigned short TFTPRequest::getOpcode() const
+{
+	return this->opcode;
+}
+
+/**
+ * @brief Requested file as sent by client, may contain any byte except NUL
+ * @return filename
+ */
+const TFTPRequest::view & TFTPRequest::getFilename() const
+{
+	return this->filename;
+}
+
+/**
+ * @brief Transfer mode
+ * @return mode
+ */
+const TFTPRequest::view & TFTPRequest::getMode() const
+{
+	return this->mode;
+}
+
+/**
+ * @brief Number of options
+ * @return count
+ */
+unsigned int TFTPRequest::getCount() const
+{
+	return this->count;
+}
+
+/**
+ * @brief Option in order of request
+ * @param i index below getCount
+ * @return key and value
+ */
+const TFTPRequest::option & TFTPRequest::getOption(unsigned int i) const
+{
+	return this->options[i];
+}
+
+/**
+ * @brief Parse decimal option value without exceptions of std::stoll
+ * @param value option value
+ * @return number
+ * @throws TFTPProtocolException OPTION if value is empty, not a number or too big
+ */
+long long TFTPRequest::number(const view & value)
+{
+	long long result = 0;
+	int digit;
+
+	if(value.length == 0)
+	{
+		throw TFTPProtocolException(TFTPProtocolException::OPTION);
+	}
+
+	for(std::size_t i = 0; i < value.length; ++i)
+	{
+		digit = value.data[i] - '0';
+
+		if(digit < 0 || digit > 9 || result > (LLONG_MAX - digit) / 10)
+		{
+			throw TFTPProtocolException(TFTPProtocolException::OPTION);
+		}
+
+		result = result * 10 + digit;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Take NUL terminated field
+ * @param position start of field, moved behind its NUL
+ * @param end end of datagram
+ * @return field or view with nullptr data if datagram ends before NUL
+ */
+TFTPRequest::view TFTPRequest::field(const char * & position, const char * end)
+{
+	view result;
+	const char * terminator = position < end ? (const char *) memchr(position, '\0', end - position) : nullptr;
+
+	if(terminator == nullptr)
+	{
+		position = end;
+		return result;
+	}
+
+	result.data = position;
+	result.length = terminator - position;
+	position = terminator + 1;
+
+	return result;
+}
@@ -0,0 +1,50 @@
+#ifndef H_TFTPREQUEST
+#define H_TFTPREQUEST
+
+#include "tftpprotocolexception.h"
+#include <cstring>
+#include <cstddef>
+#include <climits>
+#include <string>
+
+class TFTPRequest
+{
+	public:
+		// bytes inside datagram, not terminated
+		struct view
+		{
+			const char * data = nullptr;
+			std::size_t length = 0;
+
+			bool equals(const char * literal) const;
+			std::string str() const;
+		};
+
+		struct option
+		{
+			view key;
+			view value;
+		};
+
+		static const unsigned int MAX_OPTIONS = 16;
+
+	private:
+		unsigned short opcode = 0;
+		view filename;
+		view mode;
+		option options[MAX_OPTIONS];
+		unsigned int count = 0;
+
+		static view field(const char * & position, const char * end);
+
+	public:
+		TFTPRequest(const char * data, std::size_t length);
+		unsigned short getOpcode() const;
+		const view & getFilename() const;
+		const view & getMode() const;
+		unsigned int getCount() const;
+		const option & getOption(unsigned int i) const;
+		static long long number(const view & value);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "tftprequesttable.h"
+
+TFTPRequestTable::TFTPRequestTable() : duplicates(0)
+{
+
+}
+
+/**
+ * @brief Process wide table of requests which have running session
+ * @return table
+ */
+TFTPRequestTable & TFTPRequestTable::instance()
+{
+	static TFTPRequestTable table;
+	return table;
+}
+
+/**
+ * @brief Identify request by client address, port, opcode and filename
+ * @param inaddr client address
+ * @param buffer request datagram
+ * @param length size of datagram
+ * @return key
+ */
+std::string TFTPRequestTable::key(const sockaddr * inaddr, const char * buffer, int length)
+{
+	std::string result;
+
+	if(inaddr->sa_family == AF_INET6)
+	{
+		const sockaddr_in6 * address = (const sockaddr_in6 *) inaddr;
+		result.append((const char *) &address->sin6_addr, sizeof(address->sin6_addr));
+		result.append((const char *) &address->sin6_port, sizeof(address->sin6_port));
+	}
+	else
+	{
+		const sockaddr_in * address = (const sockaddr_in *) inaddr;
+		result.append((const char *) &address->sin_addr, sizeof(address->sin_addr));
+		result.append((const char *) &address->sin_port, sizeof(address->sin_port));
+	}
+
+	// opcode and filename
+	if(length >= 2)
+	{
+		result.append(buffer, 2);
+		result.append(buffer + 2, strnlen(buffer + 2, length - 2));
+	}
+
+	return result;
+}
+
+/**
+ * @brief Register request of new session
+ * @param key key of request
+ * @return key stored in table, kept by session instead of own copy, nullptr if same request has running session (client retransmitted it)
+ */
+const std::string * TFTPRequestTable::insert(const std::string & key)
+{
+	shard & part = this->find(key);
+	std::pair<std::unordered_set<std::string>::iterator, bool> inserted;
+
+	part.lock.lock();
+	inserted = part.keys.insert(key);
+	part.lock.unlock();
+
+	if(!inserted.second)
+	{
+		++this->duplicates;
+		return nullptr;
+	}
+
+	return &*inserted.first;
+}
+
+/**
+ * @brief Session is over, same request starts new one
+ * @param key key returned by insert
+ */
+void TFTPRequestTable::remove(const std::string * key)
+{
+	shard & part = this->find(*key);
+
+	// key is the stored element itself, erase by position
+	part.lock.lock();
+	part.keys.erase(part.keys.find(*key));
+	part.lock.unlock();
+}
+
+/**
+ * @brief Print table statistics
+ */
+void TFTPRequestTable::print()
+{
+	std::cout << "Duplicate requests: " << this->duplicates << " suppressed" << std::endl;
+}
+
+/**
+ * @brief Part of table holding key, every part has own lock
+ * @param key key of request
+ * @return shard
+ */
+TFTPRequestTable::shard & TFTPRequestTable::find(const std::string & key)
+{
+	return this->shards[std::hash<std::string>()(key) % SHARDS];
+}
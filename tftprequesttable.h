@@ -0,0 +1,41 @@
+#ifndef H_TFTPREQUESTTABLE
+#define H_TFTPREQUESTTABLE
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+class TFTPRequestTable
+{
+	private:
+		static const unsigned int SHARDS = 16;
+
+		struct shard
+		{
+			std::mutex lock;
+			std::unordered_set<std::string> keys;
+		};
+
+		shard shards[SHARDS];
+
+		std::atomic<unsigned long> duplicates;
+
+		TFTPRequestTable();
+		shard & find(const std::string & key);
+
+	public:
+		static TFTPRequestTable & instance();
+		static std::string key(const sockaddr * inaddr, const char * buffer, int length);
+
+		const std::string * insert(const std::string & key);
+		void remove(const std::string * key);
+		void print();
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "tftpring.h"
+
+const unsigned int TFTPRing::ENTRIES = 1024;
+const unsigned int TFTPRing::FILES = 4096;
+const unsigned int TFTPRing::BUFFERS = 1024;
+
+/**
+ * @brief Create io_uring instance without liburing, map its queues and register empty file and buffer tables
+ * @throws TFTPException if kernel does not support io_uring or waiting with timeout (5.11)
+ */
+TFTPRing::TFTPRing()
+{
+	std::vector<int> empty(FILES, -1);
+	io_uring_rsrc_register table;
+
+	memset(&this->params, 0, sizeof(this->params));
+	this->fd = syscall(__NR_io_uring_setup, ENTRIES, &this->params);
+
+	if(this->fd < 0)
+	{
+		throw TFTPException(TFTPException::SOCKET, errno);
+	}
+
+	if(!(this->params.features & IORING_FEAT_EXT_ARG) || !(this->params.features & IORING_FEAT_NODROP))
+	{
+		close(this->fd);
+		throw TFTPException(TFTPException::SOCKET, ENOSYS);
+	}
+
+	this->sqSize = this->params.sq_off.array + this->params.sq_entries * sizeof(unsigned int);
+	this->cqSize = this->params.cq_off.cqes + this->params.cq_entries * sizeof(io_uring_cqe);
+
+	if(this->params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		this->sqSize = this->cqSize = std::max(this->sqSize, this->cqSize);
+	}
+
+	this->sqRing = mmap(NULL, this->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQ_RING);
+	this->cqRing = this->params.features & IORING_FEAT_SINGLE_MMAP ? this->sqRing
+		: mmap(NULL, this->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_CQ_RING);
+	this->sqes = (io_uring_sqe *) mmap(NULL, this->params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->fd, IORING_OFF_SQES);
+
+	if(this->sqRing == MAP_FAILED || this->cqRing == MAP_FAILED || this->sqes == MAP_FAILED)
+	{
+		int error = errno;
+		this->unmap();
+		close(this->fd);
+		throw TFTPException(TFTPException::SOCKET, error);
+	}
+
+	this->sqHead = (unsigned int *) ((char *) this->sqRing + this->params.sq_off.head);
+	this->sqTail = (unsigned int *) ((char *) this->sqRing + this->params.sq_off.tail);
+	this->sqMask = (unsigned int *) ((char *) this->sqRing + this->params.sq_off.ring_mask);
+	this->sqArray = (unsigned int *) ((char *) this->sqRing + this->params.sq_off.array);
+	this->cqHead = (unsigned int *) ((char *) this->cqRing + this->params.cq_off.head);
+	this->cqTail = (unsigned int *) ((char *) this->cqRing + this->params.cq_off.tail);
+	this->cqMask = (unsigned int *) ((char *) this->cqRing + this->params.cq_off.ring_mask);
+	this->cqes = (io_uring_cqe *) ((char *) this->cqRing + this->params.cq_off.cqes);
+	this->tail = *this->sqTail;
+
+	// sockets of sessions are put to free slots, kernel then skips fd lookup on every operation
+	if(syscall(__NR_io_uring_register, this->fd, IORING_REGISTER_FILES, empty.data(), FILES) == 0)
+	{
+		this->files = true;
+
+		for(int i = FILES - 1; i >= 0; --i)
+		{
+			this->freeSlots.push_back(i);
+		}
+	}
+
+	// slabs of buffer pool are pinned on first use, file reads then skip page lookup (READ_FIXED, 5.13)
+	memset(&table, 0, sizeof(table));
+	table.nr = BUFFERS;
+	table.flags = IORING_RSRC_REGISTER_SPARSE;
+
+	if(syscall(__NR_io_uring_register, this->fd, IORING_REGISTER_BUFFERS2, &table, sizeof(table)) == 0)
+	{
+		this->buffers = true;
+		this->fixed.assign(BUFFERS, 0);
+	}
+}
+
+/**
+ * @brief Close instance, pending operations are cancelled by kernel
+ */
+TFTPRing::~TFTPRing()
+{
+	this->unmap();
+	close(this->fd);
+}
+
+/**
+ * @brief Unmap queues
+ */
+void TFTPRing::unmap()
+{
+	if(this->sqes != MAP_FAILED)
+	{
+		munmap(this->sqes, this->params.sq_entries * sizeof(io_uring_sqe));
+	}
+
+	if(this->cqRing != MAP_FAILED && this->cqRing != this->sqRing)
+	{
+		munmap(this->cqRing, this->cqSize);
+	}
+
+	if(this->sqRing != MAP_FAILED)
+	{
+		munmap(this->sqRing, this->sqSize);
+	}
+}
+
+/**
+ * @brief Get empty SQE, submit queued ones if ring is full
+ * @return SQE, published by next submit
+ */
+io_uring_sqe * TFTPRing::next()
+{
+	io_uring_sqe * sqe;
+
+	while(this->tail - __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE) >= this->params.sq_entries)
+	{
+		__atomic_store_n(this->sqTail, this->tail, __ATOMIC_RELEASE);
+
+		if(this->enter(this->tail - __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE), 0, 0, NULL, 0) < 0 && errno != EINTR && errno != EBUSY)
+		{
+			throw TFTPException(TFTPException::SOCKET, errno);
+		}
+	}
+
+	sqe = &this->sqes[this->tail & *this->sqMask];
+	memset(sqe, 0, sizeof(*sqe));
+	this->sqArray[this->tail & *this->sqMask] = this->tail & *this->sqMask;
+	++this->tail;
+
+	return sqe;
+}
+
+/**
+ * @brief Submit queued SQEs and wait for at least one completion, single syscall
+ * @param timeout max wait in milliseconds
+ * @return number of submitted SQEs or -1 (timeout, signal)
+ */
+int TFTPRing::submit(int timeout)
+{
+	io_uring_getevents_arg arg;
+	__kernel_timespec ts;
+
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000L;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.ts = (uint64_t) &ts;
+
+	__atomic_store_n(this->sqTail, this->tail, __ATOMIC_RELEASE);
+
+	return this->enter(this->tail - __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE), 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+/**
+ * @brief Take one completion
+ * @param cqe copy of completion
+ * @return false if there is none
+ */
+bool TFTPRing::reap(io_uring_cqe & cqe)
+{
+	unsigned int head = *this->cqHead;
+
+	if(head == __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE))
+	{
+		return false;
+	}
+
+	cqe = this->cqes[head & *this->cqMask];
+	__atomic_store_n(this->cqHead, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * @brief Put socket to registered file table
+ * @param sck socket descriptor
+ * @return slot used with IOSQE_FIXED_FILE or -1 if table is full or not supported
+ */
+int TFTPRing::registerFile(int sck)
+{
+	io_uring_files_update update;
+	int slot;
+
+	if(!this->files || this->freeSlots.empty())
+	{
+		return -1;
+	}
+
+	slot = this->freeSlots.back();
+
+	memset(&update, 0, sizeof(update));
+	update.offset = slot;
+	update.fds = (uint64_t) &sck;
+
+	if(syscall(__NR_io_uring_register, this->fd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+	{
+		return -1;
+	}
+
+	this->freeSlots.pop_back();
+
+	return slot;
+}
+
+/**
+ * @brief Release slot of registered file table, no operation may use it
+ * @param slot slot returned by registerFile
+ */
+void TFTPRing::unregisterFile(int slot)
+{
+	io_uring_files_update update;
+	int none = -1;
+
+	if(slot < 0)
+	{
+		return;
+	}
+
+	memset(&update, 0, sizeof(update));
+	update.offset = slot;
+	update.fds = (uint64_t) &none;
+
+	syscall(__NR_io_uring_register, this->fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+	this->freeSlots.push_back(slot);
+}
+
+/**
+ * @brief Register slab of buffer pool holding buffer
+ * @param buffer buffer from TFTPBufferPool
+ * @return buf_index for IORING_OP_READ_FIXED or -1 if buffer cannot be registered
+ */
+int TFTPRing::registerBuffer(const char * buffer)
+{
+	io_uring_rsrc_update2 update;
+	iovec slab;
+	char * base;
+	int index;
+
+	if(!this->buffers)
+	{
+		return -1;
+	}
+
+	index = TFTPBufferPool::instance().slab(buffer, base);
+
+	if(index < 0 || index >= (int) BUFFERS || this->fixed[index] == 2)
+	{
+		return -1;
+	}
+
+	if(this->fixed[index] == 0)
+	{
+		slab.iov_base = base;
+		slab.iov_len = TFTPBufferPool::SLAB;
+
+		memset(&update, 0, sizeof(update));
+		update.offset = index;
+		update.data = (uint64_t) &slab;
+		update.nr = 1;
+
+		if(syscall(__NR_io_uring_register, this->fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) != 1)
+		{
+			this->fixed[index] = 2;
+			return -1;
+		}
+
+		this->fixed[index] = 1;
+	}
+
+	return index;
+}
+
+/**
+ * @brief io_uring_enter(2) has no libc wrapper
+ * @param submit number of SQEs to submit
+ * @param wait number of completions to wait for
+ * @param flags IORING_ENTER_*
+ * @param arg signal mask or extended argument
+ * @param size size of arg
+ * @return syscall result
+ */
+int TFTPRing::enter(unsigned int submit, unsigned int wait, unsigned int flags, void * arg, std::size_t size)
+{
+	return syscall(__NR_io_uring_enter, this->fd, submit, wait, flags, arg, size);
+}
@@ -0,0 +1,76 @@
+#ifndef H_TFTPRING
+#define H_TFTPRING
+
+#include "tftpexception.h"
+#include "tftpbufferpool.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+
+class TFTPRing
+{
+	public:
+		// submitted operation, its address is user_data of SQE
+		struct operation
+		{
+			int type;
+			void * owner; // session or loop
+			void * data; // SEND, READ: buffers of datagram
+		};
+
+		static const int WAKEUP = 0; // poll of eventfd
+		static const int RECEIVE = 1;
+		static const int SEND = 2;
+		static const int READ = 3; // block of file into buffer of datagram
+
+		static const unsigned int ENTRIES;
+		static const unsigned int FILES;
+		static const unsigned int BUFFERS; // slabs of buffer pool which can be registered
+
+	private:
+		int fd;
+		io_uring_params params;
+		void * sqRing = MAP_FAILED;
+		void * cqRing = MAP_FAILED;
+		std::size_t sqSize = 0;
+		std::size_t cqSize = 0;
+		io_uring_sqe * sqes = (io_uring_sqe *) MAP_FAILED;
+
+		unsigned int * sqHead;
+		unsigned int * sqTail;
+		unsigned int * sqMask;
+		unsigned int * sqArray;
+		unsigned int * cqHead;
+		unsigned int * cqTail;
+		unsigned int * cqMask;
+		io_uring_cqe * cqes;
+		unsigned int tail; // next free SQE, published on enter
+
+		bool files = false; // sparse table of registered files
+		std::vector<int> freeSlots;
+		bool buffers = false; // sparse table of registered buffers, index is slab of pool
+		std::vector<char> fixed; // per slab: 0 not tried, 1 registered, 2 refused (RLIMIT_MEMLOCK)
+
+		void unmap();
+		int enter(unsigned int submit, unsigned int wait, unsigned int flags, void * arg, std::size_t size);
+
+	public:
+		TFTPRing();
+		~TFTPRing();
+		io_uring_sqe * next();
+		int submit(int timeout);
+		bool reap(io_uring_cqe & cqe);
+		int registerFile(int sck);
+		void unregisterFile(int slot);
+		int registerBuffer(const char * buffer);
+};
+
+#endif
@@ -3,16 +3,23 @@
 
 Params TFTPServer::params;
 std::mutex TFTPServer::shutdownLock;
+std::atomic<bool> TFTPServer::reportPending(false);
 const int TFTPServer::MAX_BLOCKSIZE = 65464;
+const int TFTPServer::BATCH = 32;
 
-TFTPServer::TFTPServer()
+TFTPServer::TFTPServer() : listening(true), batches(0), datagrams(0), dropped(0), maxBatch(0)
 {
 
 }
 
 TFTPServer::~TFTPServer()
 {
-	this->mainLock.lock();
+	for(std::vector<TFTPEventLoop *>::iterator it = this->loops.begin(); it != this->loops.end(); ++it)
+	{
+		delete *it;
+	}
+
+	delete this->steering;
 }
 
 void TFTPServer::terminate(int sig)
@@ -20,6 +27,29 @@ void TFTPServer::terminate(int sig)
 	TFTPServer::shutdownLock.unlock();
 }
 
+/**
+ * @brief Signal handler of SIGUSR1, statistics are printed by event loop, not in handler
+ * @param sig signal (unused)
+ */
+void TFTPServer::requestReport(int)
+{
+	TFTPServer::reportPending = true;
+}
+
+/**
+ * @brief Print counters of running server if they were requested by SIGUSR1
+ */
+void TFTPServer::report()
+{
+	if(!TFTPServer::reportPending.exchange(false))
+	{
+		return;
+	}
+
+	TFTPShaper::instance().print();
+	TFTPAdmission::instance().print();
+}
+
 /**
  * @brief Construct sockets and validate parameters
  * @param params parameters
@@ -36,11 +66,63 @@ void TFTPServer::configure(Params & params)
 		throw TFTPException(TFTPException::NOT_SET);
 	}
 
+	for(const std::string & limit : params.limits)
+	{
+		TFTPShaper::instance().add(limit);
+	}
+
+	TFTPAdmission::instance().configure(params.maxSessions, params.maxPerClient, params.maxPerFile, params.queueLength, params.queueTime);
+
+	if(!params.steering.empty() && params.listeners > 1)
+	{
+		this->steering = new TFTPSteering(params.steering, params.listeners);
+		params.steering = this->steering->getMode();
+	}
+
 	for(Params::fullAddrVector::iterator it = params.addresses.begin(); it != params.addresses.end(); ++it)
 	{
 		std::tie(address, port, ipv6, std::ignore, std::ignore, std::ignore) = (*it);
-		sck = TFTPServer::createSocket(address, port, ipv6);
-		std::get<3>(*it) = sck;
+
+		// kernel spreads datagrams among sockets of one address by hash of client address
+		for(int i = 0; i < params.listeners; ++i)
+		{
+			sck = TFTPServer::createSocket(address, port, ipv6, params.listeners > 1);
+			this->listeners.push_back(std::make_pair(sck, nullptr));
+
+			if(i == 0)
+			{
+				std::get<3>(*it) = sck;
+			}
+		}
+
+		// program applies to whole group
+		if(this->steering != nullptr)
+		{
+			this->steering->attach(std::get<3>(*it), ipv6);
+		}
+
+		// transfer sockets for one full batch of requests
+		TFTPSocketPool::instance().fill(address, ipv6, BATCH);
+	}
+
+	for(int i = 0; i < params.workers; ++i)
+	{
+		this->loops.push_back(new TFTPEventLoop(params.uring, this, i));
+	}
+
+	// loop falls back to epoll if kernel refused io_uring
+	params.uring = params.uring && this->loops.front()->hasRing();
+
+	TFTPFileCache::instance().setCapacity((std::size_t) params.cache << 20);
+	TFTPDescriptorCache::instance().setCapacity(params.descriptors);
+	TFTPBufferPool::instance().setHuge(params.hugePages);
+	TFTPWriter::instance().start(params.sync);
+	TFTPFileCache::instance().start();
+	TFTPNetasciiCache::instance().start();
+
+	if(!std::get<0>(params.multicast).empty())
+	{
+		TFTPMulticast::configure(std::get<0>(params.multicast), std::get<1>(params.multicast), std::get<2>(params.multicast));
 	}
 
 	params.print();
@@ -57,14 +139,19 @@ void TFTPServer::configure(Params & params)
  * @param address address to lister
  * @param port port number
  * @param ipv6 ip version
+ * @param reuse socket is one of several sockets bound to the same address (SO_REUSEPORT)
  * @return socket descriptor
  */
-int TFTPServer::createSocket(std::string & address, unsigned short port, bool ipv6)
+int TFTPServer::createSocket(std::string & address, unsigned short port, bool ipv6, bool reuse)
 {
-	sockaddr * addr;
+	sockaddr_storage storage; // transfer sockets are created per session when pool is empty, no heap
+	sockaddr * addr = (sockaddr *) &storage;
 	socklen_t socklen;
 	int sck;
 	int result;
+	int enable = 1;
+
+	memset(&storage, 0, sizeof(storage));
 
 	if(ipv6)
 	{
@@ -75,14 +162,12 @@ int TFTPServer::createSocket(std::string & address, unsigned short port, bool ip
 			throw TFTPException(TFTPException::SOCKET);
 		}
 
-		sockaddr_in6 * inaddr = new sockaddr_in6;
+		sockaddr_in6 * inaddr = (sockaddr_in6 *) addr;
 
 		inaddr->sin6_family = AF_INET6;
 		inaddr->sin6_port = htons(port);
 		socklen = sizeof(sockaddr_in6);
 		inet_pton(AF_INET6, address.c_str(), &(inaddr->sin6_addr.s6_addr));
-
-		addr = (sockaddr *) inaddr;
 	}
 	else
 	{
@@ -93,18 +178,21 @@ int TFTPServer::createSocket(std::string & address, unsigned short port, bool ip
 			throw TFTPException(TFTPException::SOCKET);
 		}
 
-		sockaddr_in * inaddr = new sockaddr_in;
+		sockaddr_in * inaddr = (sockaddr_in *) addr;
 
 		inaddr->sin_family = AF_INET;
 		inaddr->sin_port = htons(port);
 		socklen = sizeof(sockaddr_in);
 		inet_pton(AF_INET, address.c_str(), &(inaddr->sin_addr.s_addr));
+	}
 
-		addr = (sockaddr *) inaddr;
+	if(reuse && setsockopt(sck, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0)
+	{
+		close(sck);
+		throw TFTPException(TFTPException::SOCKET, errno);
 	}
 
 	result = bind(sck, addr, socklen);
-	delete addr;
 
 	if(result != 0)
 	{
@@ -125,107 +213,264 @@ void TFTPServer::shutdown()
 	int sck;
 	std::thread * thread;
 
-	for(Params::fullAddrVector::iterator it = TFTPServer::params.addresses.begin(); it != TFTPServer::params.addresses.end(); ++it)
+	this->listening = false;
+
+	for(std::vector<std::pair<int, std::thread *>>::iterator it = this->listeners.begin(); it != this->listeners.end(); ++it)
 	{
-		sck = std::get<3>(*it);
+		sck = it->first;
+		::shutdown(sck, SHUT_RDWR);
+		close(sck);
+		thread = it->second;
 
-		if(sck == Params::NOT_SET)
+		if(thread != nullptr)
 		{
-			break;
+			thread->join();
+			delete thread;
 		}
+	}
 
-		::shutdown(sck, SHUT_RDWR);
-		close(sck);
-		thread = std::get<4>(*it);
-		thread->join();
-		delete thread;
+	// let active transfers finish
+	for(std::vector<TFTPEventLoop *>::iterator it = this->loops.begin(); it != this->loops.end(); ++it)
+	{
+		(*it)->drain();
 	}
+
+	TFTPWriter::instance().stop(); // uploads of aborted transfers
+	TFTPFileCache::instance().stop();
+	TFTPNetasciiCache::instance().stop();
+	TFTPAdmission::instance().clear();
+
+	std::cout << "Listener: " << this->datagrams << " requests in " << this->batches << " batches (max " << this->maxBatch << "), " << this->dropped << " dropped by kernel" << std::endl;
+	TFTPDescriptorCache::instance().print();
+	TFTPFileCache::instance().print();
+	TFTPNetasciiCache::instance().print();
+	TFTPSocketPool::instance().print();
+	TFTPRequestTable::instance().print();
+	TFTPWriter::instance().print();
+	TFTPBufferPool::instance().print();
+	TFTPSessionTable::instance().print();
+	TFTPShaper::instance().print();
+	TFTPAdmission::instance().print();
 }
 
 /**
- * @brief Run threads for every listening socket
+ * @brief Run event loops and threads for every listening socket, n-th socket of address and n-th loop share core
  */
 void TFTPServer::start()
 {
-	for(Params::fullAddrVector::iterator it = this->params.addresses.begin(); it != this->params.addresses.end(); ++it)
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	unsigned int shard;
+	Params::fullAddr addr;
+
+	for(unsigned int i = 0; i < this->loops.size(); ++i)
+	{
+		this->loops[i]->start(i % cores);
+	}
+
+	for(unsigned int i = 0; i < this->listeners.size(); ++i)
 	{
-		std::thread * thread = new std::thread(&TFTPServer::socketListen, this, *it);
-		std::get<4>(*it) = thread;
+		shard = i % this->params.listeners;
+		addr = this->params.addresses[i / this->params.listeners];
+		std::get<3>(addr) = this->listeners[i].first;
+		std::thread * thread = new std::thread(&TFTPServer::socketListen, this, addr, shard);
+		this->listeners[i].second = thread;
+		TFTPServer::pin(thread, shard % cores);
 	}
 
 	this->shutdownLock.lock();
 }
 
 /**
- * @brief Listen on socket
+ * @brief Bind thread to single core
+ * @param thread thread
+ * @param cpu core number
+ */
+void TFTPServer::pin(std::thread * thread, unsigned int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(thread->native_handle(), sizeof(set), &set); // not fatal, thread just migrates
+}
+
+/**
+ * @brief Listen on socket, receive requests in batches
  * @param addr parameters
+ * @param shard index of socket among sockets of the address
  */
-void TFTPServer::socketListen(Params::fullAddr addr)
+void TFTPServer::socketListen(Params::fullAddr addr, unsigned int shard)
 {
 	int sck = std::get<3>(addr);
-	int bytes;
-	bool ipv6 = std::get<2>(addr);
-	char buffer[513] = {0};
+	int count;
+	int enable = 1;
 	std::string address = std::get<0>(addr);
 
+	// preallocated slots for single batch
+	mmsghdr msgs[BATCH];
+	iovec iov[BATCH];
+	sockaddr_storage inaddr[BATCH];
+	char buffer[BATCH][514];
+	char control[BATCH][CMSG_SPACE(sizeof(uint32_t))];
+	uint32_t overflow = 0;
+
+	std::vector<TFTPClient *> clients;
 	TFTPClient * client;
-	sockaddr * inaddr;
-	socklen_t socklen;
+	int admission;
+	std::string request;
+	const std::string * key;
+	cmsghdr * cmsg;
+
+	// kernel reports number of datagrams dropped on full receive queue
+	setsockopt(sck, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for(int i = 0; i < BATCH; ++i)
+	{
+		iov[i].iov_base = buffer[i];
+		iov[i].iov_len = 513;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &inaddr[i];
+		msgs[i].msg_hdr.msg_control = control[i];
+	}
 
 	while(true)
 	{
-		if(ipv6)
+		for(int i = 0; i < BATCH; ++i)
+		{
+			msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+			msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+		}
+
+		count = recvmmsg(sck, msgs, BATCH, MSG_WAITFORONE, NULL);
+
+		if(!this->listening)
 		{
-			inaddr = (sockaddr *) new sockaddr_in6;
-			socklen = sizeof(sockaddr_in6);
+			break; // socket closed
 		}
-		else
+
+		if(count <= 0)
 		{
-			inaddr = (sockaddr *) new sockaddr_in;
-			socklen = sizeof(sockaddr_in);
+			if(errno == EINTR) continue;
+			break;
 		}
 
-		bytes = recvfrom(sck, buffer, 513, 0, (sockaddr *) inaddr, &socklen);
+		++this->batches;
+		this->datagrams += count;
 
-		if(bytes == 0)
+		if((unsigned int) count > this->maxBatch)
 		{
-			delete inaddr;
-			break; // socket closed
+			this->maxBatch = count;
+		}
+
+		for(int i = 0; i < count; ++i)
+		{
+			for(cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+			{
+				if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+				{
+					uint32_t value;
+					memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+					this->dropped += value - overflow;
+					overflow = value;
+				}
+			}
+
+			buffer[i][msgs[i].msg_len] = '\0';
+			request = TFTPRequestTable::key((sockaddr *) &inaddr[i], buffer[i], msgs[i].msg_len);
+
+			key = TFTPRequestTable::instance().insert(request);
+
+			if(key == nullptr)
+			{
+				continue; // retransmitted request, its session answers on timeout
+			}
+
+			client = new TFTPClient(address, (sockaddr *) &inaddr[i], msgs[i].msg_hdr.msg_namelen, buffer[i], msgs[i].msg_len, this->params, std::get<5>(addr), key);
+
+			if(TFTPAdmission::instance().enabled() && !client->isDone())
+			{
+				admission = TFTPAdmission::instance().admit(client, client->getAddress(), client->getFilename(), client->isRead());
+
+				if(admission == TFTPAdmission::QUEUED)
+				{
+					continue; // started by loop once other session ends
+				}
+
+				if(admission == TFTPAdmission::REJECTED)
+				{
+					client->reject();
+					delete client;
+					continue;
+				}
+			}
+
+			clients.push_back(client);
 		}
 
-		client = new TFTPClient(address, inaddr, socklen, buffer, bytes, this->params, std::get<5>(addr));
-		std::thread thread(&TFTPServer::clientThread, this, client);
-		thread.detach();
-		memset(buffer, 0, 513);
+		this->dispatch(clients, shard % this->loops.size());
+		clients.clear();
 	}
 }
 
 /**
- * @brief Handle client thread
- * @param client Client object
+ * @brief Hand batch of new sessions over to least loaded event loops, one wakeup per loop
+ * @param clients new sessions
+ * @param home loop on the same core as listener, preferred when loads are equal, used even if it is draining
  */
-void TFTPServer::clientThread(TFTPClient * client)
+void TFTPServer::dispatch(std::vector<TFTPClient *> & clients, unsigned int home)
 {
-	this->clientLock.lock();
+	std::vector<std::vector<TFTPClient *>> batch(this->loops.size());
+	std::vector<unsigned int> load(this->loops.size());
+	unsigned int best;
 
-	if(this->clientCount++ == 0)
+	for(unsigned int i = 0; i < this->loops.size(); ++i)
 	{
-		this->mainLock.lock();
+		// draining loop may stop before it sees new sessions
+		load[i] = this->loops[i]->isDraining() ? UINT_MAX : this->loops[i]->size();
 	}
 
-	this->clientLock.unlock();
+	for(std::vector<TFTPClient *>::iterator it = clients.begin(); it != clients.end(); ++it)
+	{
+		best = home;
 
-	client->work();
+		for(unsigned int i = 0; i < load.size(); ++i)
+		{
+			if(load[i] < load[best])
+			{
+				best = i;
+			}
+		}
 
-	this->clientLock.lock();
+		batch[best].push_back(*it);
+		++load[best];
+	}
 
-	if(--this->clientCount == 0)
+	if(this->steering != nullptr)
 	{
-		this->mainLock.unlock();
+		// next requests go to socket on the core of least loaded loop
+		best = 0;
+
+		for(unsigned int i = 1; i < (unsigned int) this->params.listeners; ++i)
+		{
+			if(load[i % load.size()] < load[best % load.size()])
+			{
+				best = i;
+			}
+		}
+
+		this->steering->update(best);
 	}
 
-	this->clientLock.unlock();
-	delete client;
+	for(unsigned int i = 0; i < this->loops.size(); ++i)
+	{
+		if(!batch[i].empty())
+		{
+			this->loops[i]->add(batch[i]);
+		}
+	}
 }
 
 /**
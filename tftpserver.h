@@ -3,7 +3,12 @@
 
 #include "params.h"
 #include "tftpclient.h"
+#include "tftpeventloop.h"
 #include "tftpexception.h"
+#include "tftpsteering.h"
+#include "tftpwriter.h"
+#include "tftpbufferpool.h"
+#include "tftpshaper.h"
 #include <sys/socket.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -19,33 +24,47 @@
 #include <sys/types.h>
 #include <ifaddrs.h>
 #include <map>
-#include <mutex>
+#include <atomic>
+#include <climits>
+#include <pthread.h>
 
 class TFTPServer
 {
 	static Params params;
 	static std::mutex shutdownLock;
-	std::mutex mainLock;
-	std::mutex clientLock;
-	unsigned int clientCount = 0;
+	static std::atomic<bool> reportPending; // SIGUSR1 arrived, first loop prints statistics
+	std::vector<TFTPEventLoop *> loops;
+	std::vector<std::pair<int, std::thread *>> listeners; // socket and thread, params.listeners sockets per address
+	std::atomic<bool> listening;
+	TFTPSteering * steering = nullptr;
+
+	// listener statistics
+	std::atomic<unsigned long> batches;
+	std::atomic<unsigned long> datagrams;
+	std::atomic<unsigned long> dropped;
+	std::atomic<unsigned int> maxBatch;
 
 	public:
 		static const int MAX_BLOCKSIZE;
+		static const int BATCH;
 
 	private:
-		void socketListen(Params::fullAddr addr);
-		void clientThread(TFTPClient * client);
+		void socketListen(Params::fullAddr addr, unsigned int shard);
 		void mtu(int sck);
 
 	public:
-		static int createSocket(std::string & address, unsigned short port, bool ipv6);
+		static int createSocket(std::string & address, unsigned short port, bool ipv6, bool reuse = false);
+		static void pin(std::thread * thread, unsigned int cpu);
 		static void terminate(int sig);
+		static void requestReport(int sig);
+		static void report();
 
 		TFTPServer();
 		~TFTPServer();
 		void configure(Params & params);
 		void start();
 		void shutdown();
+		void dispatch(std::vector<TFTPClient *> & clients, unsigned int home);
 };
 
 #endif
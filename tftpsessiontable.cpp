@@ -0,0 +1,122 @@
+#include "tftpsessiontable.h"
+#include "tftpclient.h"
+
+const std::size_t TFTPSessionTable::LINE = 64;
+const std::size_t TFTPSessionTable::CHUNK = 1024;
+
+TFTPSessionTable::TFTPSessionTable() : live(0), peak(0)
+{
+	this->slot = (sizeof(TFTPClient) + LINE - 1) / LINE * LINE;
+}
+
+/**
+ * @brief Process wide table of session records
+ * @return table
+ */
+TFTPSessionTable & TFTPSessionTable::instance()
+{
+	static TFTPSessionTable table;
+	return table;
+}
+
+/**
+ * @brief Get slot for new session, chunks are never returned to system
+ * @param size size of session record
+ * @return slot aligned to cache line
+ */
+void * TFTPSessionTable::acquire(std::size_t size)
+{
+	void * session;
+	unsigned long count;
+
+	if(size > this->slot)
+	{
+		throw std::bad_alloc();
+	}
+
+	this->lock.lock();
+
+	if(this->free.empty())
+	{
+		try
+		{
+			this->grow();
+		}
+		catch(std::bad_alloc & e)
+		{
+			this->lock.unlock();
+			throw;
+		}
+	}
+
+	session = this->free.back();
+	this->free.pop_back();
+	this->lock.unlock();
+
+	count = ++this->live;
+
+	if(count > this->peak)
+	{
+		this->peak = count;
+	}
+
+	return session;
+}
+
+/**
+ * @brief Return slot of destroyed session
+ * @param session slot from acquire
+ */
+void TFTPSessionTable::release(void * session)
+{
+	if(session == nullptr)
+	{
+		return;
+	}
+
+	--this->live;
+
+	this->lock.lock();
+	this->free.push_back(session);
+	this->lock.unlock();
+}
+
+/**
+ * @brief Shared copy of string repeated in many sessions (directory, local address)
+ * @param value string
+ * @return copy valid until process exits
+ */
+const std::string * TFTPSessionTable::intern(const std::string & value)
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+	return &*this->strings.insert(value).first;
+}
+
+/**
+ * @brief Print size of session record and peak number of sessions
+ */
+void TFTPSessionTable::print()
+{
+	std::cout << "Sessions: " << this->slot << " B per session, peak " << this->peak << ", " << this->chunks.size() << " chunks of " << CHUNK << std::endl;
+}
+
+/**
+ * @brief Map new chunk and split it into free slots, lock must be held
+ */
+void TFTPSessionTable::grow()
+{
+	void * chunk = mmap(NULL, CHUNK * this->slot, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(chunk == MAP_FAILED)
+	{
+		throw std::bad_alloc();
+	}
+
+	this->chunks.push_back((char *) chunk);
+
+	// lowest address is handed out first
+	for(std::size_t i = CHUNK; i > 0; --i)
+	{
+		this->free.push_back((char *) chunk + (i - 1) * this->slot);
+	}
+}
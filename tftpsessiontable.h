@@ -0,0 +1,42 @@
+#ifndef H_TFTPSESSIONTABLE
+#define H_TFTPSESSIONTABLE
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+class TFTPSessionTable
+{
+	public:
+		static const std::size_t LINE; // cache line, slots are aligned to it
+		static const std::size_t CHUNK; // sessions per contiguous chunk
+
+	private:
+		std::mutex lock;
+		std::vector<char *> chunks;
+		std::vector<void *> free; // slots of finished sessions, reused first
+		std::size_t slot; // size of session record rounded up to cache lines
+		std::unordered_set<std::string> strings; // interned, never removed
+
+		std::atomic<unsigned long> live;
+		std::atomic<unsigned long> peak;
+
+		TFTPSessionTable();
+		void grow();
+
+	public:
+		static TFTPSessionTable & instance();
+
+		void * acquire(std::size_t size);
+		void release(void * session);
+		const std::string * intern(const std::string & value);
+		void print();
+};
+
+#endif
@@ -0,0 +1,344 @@
+#include "tftpshaper.h"
+
+const std::string TFTPShaper::GLOBAL = "global";
+const std::string TFTPShaper::HOST = "host";
+const std::size_t TFTPShaper::MIN_BURST = 65536;
+const std::size_t TFTPShaper::MAX_IDLE_HOSTS = 4096;
+
+/**
+ * @brief Full bucket
+ * @param rate bytes per second
+ * @param burst capacity in bytes
+ */
+TFTPShaper::bucket::bucket(double rate, double burst) : rate(rate), burst(burst), tokens(burst), updated(clock::now()), throttled(0), deferrals(0)
+{
+
+}
+
+TFTPShaper::TFTPShaper() : hostsThrottled(0), hostsDeferrals(0)
+{
+
+}
+
+/**
+ * @brief Process wide rate limits
+ * @return shaper
+ */
+TFTPShaper & TFTPShaper::instance()
+{
+	static TFTPShaper shaper;
+	return shaper;
+}
+
+/**
+ * @brief Add rate limit, called before transfers start
+ * @param spec global|host|address/prefix,rate[,burst], sizes in bytes with optional K, M or G
+ * @throws std::invalid_argument malformed limit
+ */
+void TFTPShaper::add(const std::string & spec)
+{
+	std::size_t first = spec.find(',');
+	std::size_t second;
+	std::string target;
+	double rate;
+	double burst;
+	subnet net;
+	std::size_t slash;
+
+	if(first == std::string::npos)
+	{
+		throw std::invalid_argument("limit");
+	}
+
+	second = spec.find(',', first + 1);
+	target = spec.substr(0, first);
+	rate = TFTPShaper::parseRate(spec.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1));
+	burst = second == std::string::npos ? rate / 10 : TFTPShaper::parseRate(spec.substr(second + 1)); // 100 ms of traffic
+	burst = std::max(burst, (double) MIN_BURST);
+
+	if(target == GLOBAL)
+	{
+		this->global = std::make_shared<bucket>(rate, burst);
+		return;
+	}
+
+	if(target == HOST)
+	{
+		this->hostRate = rate;
+		this->hostBurst = burst;
+		return;
+	}
+
+	slash = target.find('/');
+	net.spec = spec;
+	memset(net.address, 0, sizeof(net.address));
+
+	if(inet_pton(AF_INET, target.substr(0, slash).c_str(), net.address) == 1)
+	{
+		net.family = AF_INET;
+		net.prefix = 32;
+	}
+	else if(inet_pton(AF_INET6, target.substr(0, slash).c_str(), net.address) == 1)
+	{
+		net.family = AF_INET6;
+		net.prefix = 128;
+	}
+	else
+	{
+		throw std::invalid_argument("limit");
+	}
+
+	if(slash != std::string::npos)
+	{
+		std::string prefix = target.substr(slash + 1);
+
+		if(prefix.empty() || prefix.find_first_not_of("0123456789") != std::string::npos || std::stoul(prefix) > net.prefix)
+		{
+			throw std::invalid_argument("limit");
+		}
+
+		net.prefix = std::stoul(prefix);
+	}
+
+	net.shared = std::make_shared<bucket>(rate, burst);
+	this->subnets.push_back(net);
+}
+
+/**
+ * @brief Is any limit configured?
+ * @return false if transfers are not shaped
+ */
+bool TFTPShaper::enabled()
+{
+	return this->global != nullptr || !this->subnets.empty() || this->hostRate > 0;
+}
+
+/**
+ * @brief Buckets limiting transfer to client, global first, then matching networks and client address
+ * @param addr client address
+ * @param result buckets, kept by session until it ends
+ */
+void TFTPShaper::attach(const sockaddr * addr, buckets & result)
+{
+	std::string key;
+
+	if(this->global != nullptr)
+	{
+		result.push_back(this->global);
+	}
+
+	for(const subnet & net : this->subnets)
+	{
+		if(TFTPShaper::matches(net, addr))
+		{
+			result.push_back(net.shared);
+		}
+	}
+
+	if(this->hostRate <= 0)
+	{
+		return;
+	}
+
+	if(addr->sa_family == AF_INET6)
+	{
+		key.assign((const char *) &((const sockaddr_in6 *) addr)->sin6_addr, sizeof(in6_addr));
+	}
+	else
+	{
+		key.assign((const char *) &((const sockaddr_in *) addr)->sin_addr, sizeof(in_addr));
+	}
+
+	std::lock_guard<std::mutex> guard(this->hostsLock);
+	std::shared_ptr<bucket> & host = this->hosts[key];
+
+	if(host == nullptr)
+	{
+		host = std::make_shared<bucket>(this->hostRate, this->hostBurst);
+	}
+
+	result.push_back(host);
+
+	if(this->hosts.size() > MAX_IDLE_HOSTS)
+	{
+		this->sweep();
+	}
+}
+
+/**
+ * @brief Take bytes of window from every bucket of session at once if none of them is in debt,
+ * buckets of all sessions are locked in the same order (global, networks, host)
+ * @param list buckets of session
+ * @param bytes largest size of window
+ * @return 0 if window was reserved and can be sent now, otherwise time until every bucket is out of debt
+ */
+std::chrono::microseconds TFTPShaper::reserve(const buckets & list, std::size_t bytes)
+{
+	clock::time_point now = clock::now();
+	double longest = 0;
+	double wait;
+	bucket * limiting = nullptr;
+
+	for(const std::shared_ptr<bucket> & item : list)
+	{
+		item->lock.lock();
+		item->tokens = std::min(item->burst, item->tokens + std::chrono::duration<double>(now - item->updated).count() * item->rate);
+		item->updated = now;
+		wait = item->tokens < 0 ? -item->tokens / item->rate * 1000000 : 0;
+
+		if(wait > longest)
+		{
+			longest = wait;
+			limiting = item.get();
+		}
+	}
+
+	for(const std::shared_ptr<bucket> & item : list)
+	{
+		if(limiting == nullptr)
+		{
+			item->tokens -= bytes;
+		}
+
+		item->lock.unlock();
+	}
+
+	if(limiting == nullptr)
+	{
+		return std::chrono::microseconds(0);
+	}
+
+	limiting->throttled += (long long) longest + 1;
+	++limiting->deferrals;
+
+	return std::chrono::microseconds((long long) longest + 1);
+}
+
+/**
+ * @brief Return part of reservation which was not sent (last block is short)
+ * @param list buckets of session
+ * @param bytes unused bytes
+ */
+void TFTPShaper::refund(const buckets & list, std::size_t bytes)
+{
+	for(const std::shared_ptr<bucket> & item : list)
+	{
+		item->lock.lock();
+		item->tokens = std::min(item->burst, item->tokens + bytes);
+		item->lock.unlock();
+	}
+}
+
+/**
+ * @brief Print throttled time of every limit
+ */
+void TFTPShaper::print()
+{
+	long long throttled;
+	unsigned long deferrals;
+
+	if(this->global != nullptr)
+	{
+		std::cout << "Rate limit " << GLOBAL << ": " << this->global->throttled / 1000 << " ms throttled, " << this->global->deferrals << " windows deferred" << std::endl;
+	}
+
+	for(const subnet & net : this->subnets)
+	{
+		std::cout << "Rate limit " << net.spec << ": " << net.shared->throttled / 1000 << " ms throttled, " << net.shared->deferrals << " windows deferred" << std::endl;
+	}
+
+	if(this->hostRate > 0)
+	{
+		std::lock_guard<std::mutex> guard(this->hostsLock);
+		throttled = this->hostsThrottled;
+		deferrals = this->hostsDeferrals;
+
+		for(const std::pair<const std::string, std::shared_ptr<bucket>> & host : this->hosts)
+		{
+			throttled += host.second->throttled;
+			deferrals += host.second->deferrals;
+		}
+
+		std::cout << "Rate limit " << HOST << ": " << throttled / 1000 << " ms throttled, " << deferrals << " windows deferred" << std::endl;
+	}
+}
+
+/**
+ * @brief Parse rate or burst
+ * @param src number with optional K, M or G (binary multiples)
+ * @return bytes
+ * @throws std::invalid_argument not a positive number
+ */
+double TFTPShaper::parseRate(const std::string & src)
+{
+	char * end;
+	double value = strtod(src.c_str(), &end);
+
+	switch(*end)
+	{
+		case 'K': case 'k': value *= 1024; ++end; break;
+		case 'M': case 'm': value *= 1024 * 1024; ++end; break;
+		case 'G': case 'g': value *= 1024 * 1024 * 1024; ++end; break;
+	}
+
+	if(src.empty() || *end != '\0' || !(value > 0))
+	{
+		throw std::invalid_argument("limit");
+	}
+
+	return value;
+}
+
+/**
+ * @brief Is client inside network?
+ * @param net network
+ * @param addr client address
+ * @return true if prefix matches
+ */
+bool TFTPShaper::matches(const subnet & net, const sockaddr * addr)
+{
+	const unsigned char * bytes;
+	unsigned int full = net.prefix / 8;
+	unsigned int rest = net.prefix % 8;
+
+	if(addr->sa_family != net.family)
+	{
+		return false;
+	}
+
+	if(net.family == AF_INET6)
+	{
+		bytes = (const unsigned char *) &((const sockaddr_in6 *) addr)->sin6_addr;
+	}
+	else
+	{
+		bytes = (const unsigned char *) &((const sockaddr_in *) addr)->sin_addr;
+	}
+
+	if(memcmp(bytes, net.address, full) != 0)
+	{
+		return false;
+	}
+
+	return rest == 0 || ((bytes[full] ^ net.address[full]) & (0xff << (8 - rest))) == 0;
+}
+
+/**
+ * @brief Drop host buckets no session uses, their debt is forgotten, hostsLock must be held
+ */
+void TFTPShaper::sweep()
+{
+	for(std::unordered_map<std::string, std::shared_ptr<bucket>>::iterator it = this->hosts.begin(); it != this->hosts.end();)
+	{
+		if(it->second.use_count() == 1)
+		{
+			this->hostsThrottled += it->second->throttled;
+			this->hostsDeferrals += it->second->deferrals;
+			it = this->hosts.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef H_TFTPSHAPER
+#define H_TFTPSHAPER
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <iostream>
+
+class TFTPShaper
+{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		static const std::string GLOBAL; // one bucket for all transfers
+		static const std::string HOST; // bucket per client address
+		static const std::size_t MIN_BURST; // biggest DATA packet always fits
+		static const std::size_t MAX_IDLE_HOSTS; // unused host buckets kept to remember their debt
+
+		// rate in bytes per second, tokens may go below zero by one window
+		struct bucket
+		{
+			std::mutex lock;
+			double rate;
+			double burst;
+			double tokens;
+			clock::time_point updated;
+			std::atomic<long long> throttled; // us sessions waited for this bucket
+			std::atomic<unsigned long> deferrals; // windows postponed
+
+			bucket(double rate, double burst);
+		};
+
+		using buckets = std::vector<std::shared_ptr<bucket>>;
+
+	private:
+		// shared bucket of every client in network
+		struct subnet
+		{
+			std::string spec;
+			int family;
+			unsigned char address[16];
+			unsigned int prefix;
+			std::shared_ptr<bucket> shared;
+		};
+
+		std::shared_ptr<bucket> global;
+		std::vector<subnet> subnets;
+		double hostRate = 0;
+		double hostBurst = 0;
+
+		std::mutex hostsLock;
+		std::unordered_map<std::string, std::shared_ptr<bucket>> hosts; // raw client address
+		std::atomic<long long> hostsThrottled; // us, of host buckets already dropped
+		std::atomic<unsigned long> hostsDeferrals;
+
+		TFTPShaper();
+		static double parseRate(const std::string & src);
+		static bool matches(const subnet & net, const sockaddr * addr);
+		void sweep();
+
+	public:
+		static TFTPShaper & instance();
+
+		void add(const std::string & spec);
+		bool enabled();
+		void attach(const sockaddr * addr, buckets & result);
+		std::chrono::microseconds reserve(const buckets & list, std::size_t bytes);
+		void refund(const buckets & list, std::size_t bytes);
+		void print();
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "tftpsocketpool.h"
+#include "tftpserver.h"
+
+const std::size_t TFTPSocketPool::MAX_IDLE = 256; // per local address
+
+TFTPSocketPool::TFTPSocketPool() : reused(0), created(0)
+{
+
+}
+
+/**
+ * @brief Process wide pool of transfer sockets
+ * @return pool
+ */
+TFTPSocketPool & TFTPSocketPool::instance()
+{
+	static TFTPSocketPool pool;
+	return pool;
+}
+
+/**
+ * @brief Close idle sockets
+ */
+TFTPSocketPool::~TFTPSocketPool()
+{
+	for(std::map<std::string, std::vector<int>>::iterator it = this->idle.begin(); it != this->idle.end(); ++it)
+	{
+		for(int sck : it->second)
+		{
+			close(sck);
+		}
+	}
+}
+
+/**
+ * @brief Bind sockets in advance, so first requests don't pay for it
+ * @param address local address
+ * @param ipv6 ip version
+ * @param count number of sockets
+ */
+void TFTPSocketPool::fill(std::string & address, bool ipv6, unsigned int count)
+{
+	std::vector<int> sockets;
+
+	for(unsigned int i = 0; i < count && i < MAX_IDLE; ++i)
+	{
+		sockets.push_back(this->create(address, ipv6));
+	}
+
+	this->lock.lock();
+	this->idle[address].insert(this->idle[address].end(), sockets.begin(), sockets.end());
+	this->lock.unlock();
+}
+
+/**
+ * @brief Get bound non-blocking socket on ephemeral port, new one if pool is empty
+ * @param address local address
+ * @param ipv6 ip version
+ * @return socket descriptor
+ */
+int TFTPSocketPool::acquire(std::string & address, bool ipv6)
+{
+	std::vector<int> * sockets;
+	int sck;
+
+	this->lock.lock();
+	sockets = &this->idle[address];
+
+	if(!sockets->empty())
+	{
+		sck = sockets->back();
+		sockets->pop_back();
+		this->lock.unlock();
+		++this->reused;
+		return sck;
+	}
+
+	this->lock.unlock();
+
+	return this->create(address, ipv6);
+}
+
+/**
+ * @brief Return socket of finished transfer, it is disconnected from client
+ * @param address local address
+ * @param sck socket descriptor
+ */
+void TFTPSocketPool::release(const std::string & address, int sck)
+{
+	sockaddr unspec;
+	std::vector<int> * sockets;
+
+	unspec.sa_family = AF_UNSPEC;
+
+	if(connect(sck, &unspec, sizeof(unspec)) != 0)
+	{
+		close(sck);
+		return;
+	}
+
+	this->lock.lock();
+	sockets = &this->idle[address];
+
+	if(sockets->size() < MAX_IDLE)
+	{
+		sockets->push_back(sck);
+		sck = Params::NOT_SET;
+	}
+
+	this->lock.unlock();
+
+	if(sck != Params::NOT_SET)
+	{
+		close(sck);
+	}
+}
+
+/**
+ * @brief Print pool statistics
+ */
+void TFTPSocketPool::print()
+{
+	std::cout << "Transfer sockets: " << this->created << " created, " << this->reused << " reused" << std::endl;
+}
+
+/**
+ * @brief Create non-blocking socket bound to ephemeral port
+ * @param address local address
+ * @param ipv6 ip version
+ * @return socket descriptor
+ */
+int TFTPSocketPool::create(std::string & address, bool ipv6)
+{
+	int sck = TFTPServer::createSocket(address, 0, ipv6);
+
+	fcntl(sck, F_SETFL, fcntl(sck, F_GETFL) | O_NONBLOCK);
+	++this->created;
+
+	return sck;
+}
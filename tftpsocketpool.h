@@ -0,0 +1,38 @@
+#ifndef H_TFTPSOCKETPOOL
+#define H_TFTPSOCKETPOOL
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+class TFTPSocketPool
+{
+	private:
+		static const std::size_t MAX_IDLE;
+
+		std::mutex lock;
+		std::map<std::string, std::vector<int>> idle; // bound, unconnected sockets per local address
+
+		std::atomic<unsigned long> reused;
+		std::atomic<unsigned long> created;
+
+		TFTPSocketPool();
+		int create(std::string & address, bool ipv6);
+
+	public:
+		static TFTPSocketPool & instance();
+
+		~TFTPSocketPool();
+		void fill(std::string & address, bool ipv6, unsigned int count);
+		int acquire(std::string & address, bool ipv6);
+		void release(const std::string & address, int sck);
+		void print();
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "tftpsteering.h"
+
+const std::string TFTPSteering::HASH = "hash";
+const std::string TFTPSteering::LOAD = "load";
+
+/**
+ * @brief Prepare steering program for SO_REUSEPORT groups, LOAD falls back to HASH if eBPF is not permitted
+ * @param mode HASH or LOAD
+ * @param size number of sockets in every group
+ */
+TFTPSteering::TFTPSteering(const std::string & mode, unsigned int size) : current(0)
+{
+	this->mode = mode;
+	this->size = size;
+
+	if(this->mode == LOAD)
+	{
+		this->load();
+
+		if(this->progfd < 0)
+		{
+			std::cout << "Steering: eBPF is not available (" << strerror(errno) << "), using hash" << std::endl;
+			this->mode = HASH;
+		}
+	}
+}
+
+/**
+ * @brief Release map and program, attached groups keep their copy
+ */
+TFTPSteering::~TFTPSteering()
+{
+	if(this->progfd >= 0)
+	{
+		close(this->progfd);
+	}
+
+	if(this->mapfd >= 0)
+	{
+		close(this->mapfd);
+	}
+}
+
+/**
+ * @brief Install program to group of socket, kernel then picks socket by its return value
+ * @param sck any socket of group
+ * @param ipv6 ip version of group
+ */
+void TFTPSteering::attach(int sck, bool ipv6)
+{
+	int result;
+
+	if(this->mode == LOAD)
+	{
+		result = setsockopt(sck, SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF, &this->progfd, sizeof(this->progfd));
+	}
+	else
+	{
+		// index = (last 32 bits of source address) % size
+		sock_filter code[] = {
+			BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (unsigned int) (SKF_NET_OFF + (ipv6 ? 20 : 12))),
+			BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, this->size),
+			BPF_STMT(BPF_RET | BPF_A, 0),
+		};
+		sock_fprog program;
+
+		program.len = sizeof(code) / sizeof(code[0]);
+		program.filter = code;
+		result = setsockopt(sck, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program));
+	}
+
+	if(result != 0)
+	{
+		throw TFTPException(TFTPException::SOCKET, errno);
+	}
+}
+
+/**
+ * @brief Steer next requests to socket, LOAD only
+ * @param shard index of socket in group
+ */
+void TFTPSteering::update(unsigned int shard)
+{
+	bpf_attr attr;
+	unsigned int key = 0;
+
+	if(this->mapfd < 0 || this->current.exchange(shard) == shard)
+	{
+		return;
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = this->mapfd;
+	attr.key = (uint64_t) &key;
+	attr.value = (uint64_t) &shard;
+	attr.flags = BPF_ANY;
+
+	TFTPSteering::bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+/**
+ * @brief Active mode
+ * @return HASH or LOAD
+ */
+std::string TFTPSteering::getMode()
+{
+	return this->mode;
+}
+
+/**
+ * @brief bpf(2) has no libc wrapper
+ * @param cmd command
+ * @param attr arguments
+ * @return result of command
+ */
+int TFTPSteering::bpf(int cmd, bpf_attr * attr)
+{
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/**
+ * @brief Create single element map and program returning its value: return map[0] ?: 0
+ */
+void TFTPSteering::load()
+{
+	bpf_attr attr;
+	bpf_insn code[11];
+	char license[] = "GPL";
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_ARRAY;
+	attr.key_size = sizeof(unsigned int);
+	attr.value_size = sizeof(unsigned int);
+	attr.max_entries = 1;
+
+	this->mapfd = TFTPSteering::bpf(BPF_MAP_CREATE, &attr);
+
+	if(this->mapfd < 0)
+	{
+		return;
+	}
+
+	memset(code, 0, sizeof(code));
+
+	// *(u32 *)(r10 - 4) = 0; r2 = r10 - 4
+	code[0].code = BPF_ST | BPF_MEM | BPF_W;
+	code[0].dst_reg = BPF_REG_10;
+	code[0].off = -4;
+	code[1].code = BPF_ALU64 | BPF_MOV | BPF_X;
+	code[1].dst_reg = BPF_REG_2;
+	code[1].src_reg = BPF_REG_10;
+	code[2].code = BPF_ALU64 | BPF_ADD | BPF_K;
+	code[2].dst_reg = BPF_REG_2;
+	code[2].imm = -4;
+
+	// r1 = map; r0 = bpf_map_lookup_elem(r1, r2)
+	code[3].code = BPF_LD | BPF_DW | BPF_IMM;
+	code[3].dst_reg = BPF_REG_1;
+	code[3].src_reg = BPF_PSEUDO_MAP_FD;
+	code[3].imm = this->mapfd;
+	code[5].code = BPF_JMP | BPF_CALL;
+	code[5].imm = BPF_FUNC_map_lookup_elem;
+
+	// if(r0 == NULL) return 0; return *(u32 *) r0
+	code[6].code = BPF_JMP | BPF_JEQ | BPF_K;
+	code[6].dst_reg = BPF_REG_0;
+	code[6].off = 2;
+	code[7].code = BPF_LDX | BPF_MEM | BPF_W;
+	code[7].dst_reg = BPF_REG_0;
+	code[7].src_reg = BPF_REG_0;
+	code[8].code = BPF_JMP | BPF_EXIT;
+	code[9].code = BPF_ALU64 | BPF_MOV | BPF_K;
+	code[9].dst_reg = BPF_REG_0;
+	code[10].code = BPF_JMP | BPF_EXIT;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+	attr.insns = (uint64_t) code;
+	attr.insn_cnt = sizeof(code) / sizeof(code[0]);
+	attr.license = (uint64_t) license;
+
+	this->progfd = TFTPSteering::bpf(BPF_PROG_LOAD, &attr);
+}
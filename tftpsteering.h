@@ -0,0 +1,40 @@
+#ifndef H_TFTPSTEERING
+#define H_TFTPSTEERING
+
+#include "tftpexception.h"
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <atomic>
+#include <iostream>
+
+class TFTPSteering
+{
+	public:
+		static const std::string HASH; // by client address, retransmitted request hits the same socket
+		static const std::string LOAD; // to socket whose loop has least sessions
+
+	private:
+		std::string mode;
+		unsigned int size; // sockets in every group
+		int mapfd = -1; // LOAD: index of socket for next request
+		int progfd = -1;
+		std::atomic<unsigned int> current;
+
+		static int bpf(int cmd, bpf_attr * attr);
+		void load();
+
+	public:
+		TFTPSteering(const std::string & mode, unsigned int size);
+		~TFTPSteering();
+		void attach(int sck, bool ipv6);
+		void update(unsigned int shard);
+		std::string getMode();
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "tftptimerwheel.h"
+
+/**
+ * @brief Create empty wheel, tick is one millisecond
+ */
+TFTPTimerWheel::TFTPTimerWheel()
+{
+	this->origin = clock::now();
+
+	for(int level = 0; level < LEVELS; ++level)
+	{
+		this->slots[level].resize(level == 0 ? 1 << ROOT_BITS : 1 << LEVEL_BITS);
+
+		for(timer & head : this->slots[level])
+		{
+			head.prev = head.next = &head;
+		}
+	}
+}
+
+/**
+ * @brief Arm timer, rearm if already pending, O(1)
+ * @param item timer
+ * @param when expiration time
+ */
+void TFTPTimerWheel::schedule(timer * item, clock::time_point when)
+{
+	this->cancel(item);
+	item->expires = this->ticks(when);
+	this->insert(item);
+}
+
+/**
+ * @brief Disarm timer if pending, O(1)
+ * @param item timer
+ */
+void TFTPTimerWheel::cancel(timer * item)
+{
+	if(item->next != nullptr)
+	{
+		this->unlink(item);
+	}
+}
+
+/**
+ * @brief Process every tick up to now and collect owners of expired timers
+ * @param now current time
+ * @param expired owners of expired timers
+ */
+void TFTPTimerWheel::advance(clock::time_point now, std::vector<void *> & expired)
+{
+	uint64_t target = std::chrono::duration_cast<std::chrono::milliseconds>(now - this->origin).count();
+	timer * head;
+	timer * item;
+
+	while(this->current < target)
+	{
+		++this->current;
+
+		if((this->current & ((1 << ROOT_BITS) - 1)) == 0)
+		{
+			this->cascade(1);
+		}
+
+		head = &this->slots[0][this->current & ((1 << ROOT_BITS) - 1)];
+
+		while(head->next != head)
+		{
+			item = head->next;
+			this->unlink(item);
+			expired.push_back(item->owner);
+		}
+	}
+}
+
+/**
+ * @brief Milliseconds until next pending tick
+ * @param limit max returned value, at most size of first level
+ * @return milliseconds
+ */
+int TFTPTimerWheel::next(int limit)
+{
+	uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - this->origin).count();
+	timer * head;
+
+	for(int i = 1; i <= limit; ++i)
+	{
+		head = &this->slots[0][(this->current + i) & ((1 << ROOT_BITS) - 1)];
+
+		if(head->next != head)
+		{
+			return this->current + i > now ? this->current + i - now : 0;
+		}
+	}
+
+	return limit;
+}
+
+/**
+ * @brief Convert time to tick, rounded up so timer never fires early
+ * @param when time
+ * @return tick
+ */
+uint64_t TFTPTimerWheel::ticks(clock::time_point when)
+{
+	std::chrono::microseconds offset = std::chrono::duration_cast<std::chrono::microseconds>(when - this->origin);
+
+	if(offset.count() <= 0)
+	{
+		return 0;
+	}
+
+	return (offset.count() + 999) / 1000;
+}
+
+/**
+ * @brief Put timer to slot of level covering its distance
+ * @param item timer
+ */
+void TFTPTimerWheel::insert(timer * item)
+{
+	uint64_t expires = item->expires;
+	uint64_t delta;
+	int level = 0;
+	int shift = ROOT_BITS;
+	timer * head;
+
+	if(expires <= this->current)
+	{
+		expires = this->current + 1; // overdue, next tick
+	}
+
+	delta = expires - this->current;
+
+	while(level < LEVELS - 1 && delta >= (uint64_t) 1 << shift)
+	{
+		++level;
+		shift += LEVEL_BITS;
+	}
+
+	if(delta >= (uint64_t) 1 << shift)
+	{
+		expires = this->current + ((uint64_t) 1 << shift) - 1; // beyond range, cascaded again later
+	}
+
+	if(level == 0)
+	{
+		head = &this->slots[0][expires & ((1 << ROOT_BITS) - 1)];
+	}
+	else
+	{
+		head = &this->slots[level][(expires >> (shift - LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1)];
+	}
+
+	item->next = head;
+	item->prev = head->prev;
+	head->prev->next = item;
+	head->prev = item;
+}
+
+/**
+ * @brief Remove timer from its slot
+ * @param item timer
+ */
+void TFTPTimerWheel::unlink(timer * item)
+{
+	item->prev->next = item->next;
+	item->next->prev = item->prev;
+	item->prev = item->next = nullptr;
+}
+
+/**
+ * @brief Move timers of current slot of level to lower levels, recursively when level wraps
+ * @param level level to cascade
+ */
+void TFTPTimerWheel::cascade(int level)
+{
+	int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+	unsigned int index = (this->current >> shift) & ((1 << LEVEL_BITS) - 1);
+	timer * head;
+	timer * item;
+
+	if(index == 0 && level < LEVELS - 1)
+	{
+		this->cascade(level + 1);
+	}
+
+	head = &this->slots[level][index];
+
+	while(head->next != head)
+	{
+		item = head->next;
+		this->unlink(item);
+		this->insert(item);
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef H_TFTPTIMERWHEEL
+#define H_TFTPTIMERWHEEL
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+class TFTPTimerWheel
+{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		// intrusive node, embedded in object which owns the timer
+		struct timer
+		{
+			timer * prev = nullptr;
+			timer * next = nullptr;
+			uint64_t expires = 0; // tick
+			void * owner = nullptr;
+		};
+
+		static const int LEVELS = 4;
+		static const int ROOT_BITS = 8; // 256 x 1 ms
+		static const int LEVEL_BITS = 6; // 64 x 256 ms, 64 x 16 s, 64 x 17 min
+
+	private:
+		clock::time_point origin;
+		uint64_t current = 0; // last processed tick
+		std::vector<timer> slots[LEVELS]; // list heads, circular
+
+		uint64_t ticks(clock::time_point when);
+		void insert(timer * item);
+		void unlink(timer * item);
+		void cascade(int level);
+
+	public:
+		TFTPTimerWheel();
+		void schedule(timer * item, clock::time_point when);
+		void cancel(timer * item);
+		void advance(clock::time_point now, std::vector<void *> & expired);
+		int next(int limit);
+};
+
+#endif
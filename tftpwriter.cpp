@@ -0,0 +1,339 @@
+#include "tftpwriter.h"
+#include "tftpeventloop.h"
+
+const std::string TFTPWriter::NONE = "none";
+const std::string TFTPWriter::END = "end";
+const std::string TFTPWriter::PERIODIC = "periodic";
+
+const std::size_t TFTPWriter::CHUNK = 256 * 1024;
+const std::size_t TFTPWriter::MAX_PENDING = 16 * 1024 * 1024;
+const long long TFTPWriter::SYNC_BYTES = 8 * 1024 * 1024;
+
+TFTPWriter::TFTPWriter() : policy(NONE), bytes(0), syncs(0), stalls(0)
+{
+
+}
+
+/**
+ * @brief Process wide writer of uploaded files
+ * @return writer
+ */
+TFTPWriter & TFTPWriter::instance()
+{
+	static TFTPWriter writer;
+	return writer;
+}
+
+/**
+ * @brief Start writer thread
+ * @param policy NONE, END or PERIODIC
+ */
+void TFTPWriter::start(const std::string & policy)
+{
+	this->policy = policy.empty() ? NONE : policy;
+	this->thread = new std::thread(&TFTPWriter::run, this);
+}
+
+/**
+ * @brief Write everything queued and stop writer thread
+ */
+void TFTPWriter::stop()
+{
+	if(this->thread == nullptr)
+	{
+		return;
+	}
+
+	this->lock.lock();
+	this->stopping = true;
+	this->lock.unlock();
+	this->ready.notify_one();
+
+	this->thread->join();
+	delete this->thread;
+	this->thread = nullptr;
+}
+
+/**
+ * @brief Create file of WRQ, its data are written by writer thread
+ * @param path path to file
+ * @param size announced size (tsize), space is reserved in advance, 0 if unknown
+ * @param upload state of upload, done flag tells when file is stored
+ * @return buffered stream or NULL (errno ENOSPC if announced size does not fit)
+ */
+std::FILE * TFTPWriter::open(const std::string & path, long long size, handle & upload)
+{
+	cookie_io_functions_t functions = {NULL, &TFTPWriter::write, NULL, &TFTPWriter::close};
+	std::FILE * file;
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+	if(fd < 0)
+	{
+		return NULL;
+	}
+
+	// blocks are allocated at once, file size stays as written
+	if(size > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) != 0 && errno == ENOSPC)
+	{
+		::close(fd);
+		errno = ENOSPC;
+		return NULL;
+	}
+
+	upload = std::make_shared<stream>();
+	upload->fd = fd;
+	upload->reserved = size > 0 ? size : 0;
+	upload->buffer.resize(CHUNK);
+
+	file = fopencookie(new handle(upload), "w", functions);
+
+	if(file == NULL)
+	{
+		::close(fd);
+		upload.reset();
+		return NULL;
+	}
+
+	setvbuf(file, upload->buffer.data(), _IOFBF, CHUNK);
+
+	return file;
+}
+
+/**
+ * @brief Let loop resume session once writer catches up, session never blocks on writer
+ * @param upload upload of session
+ * @param loop loop owning session
+ * @param waiter session
+ * @return false if there is nothing to wait for (file is done, or backlog of open file is below MAX_PENDING)
+ */
+bool TFTPWriter::wait(const handle & upload, TFTPEventLoop * loop, TFTPClient * waiter)
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	if(upload->done || (!upload->closed && upload->pending < MAX_PENDING))
+	{
+		return false;
+	}
+
+	if(!upload->closed)
+	{
+		++this->stalls; // window deferred
+	}
+
+	upload->loop = loop;
+	upload->waiter = waiter;
+
+	return true;
+}
+
+/**
+ * @brief Session is destroyed, writer must not resume it
+ * @param upload upload of session
+ */
+void TFTPWriter::forget(const handle & upload)
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+
+	upload->loop = nullptr;
+	upload->waiter = nullptr;
+}
+
+/**
+ * @brief Print writer statistics
+ */
+void TFTPWriter::print()
+{
+	std::cout << "Write-behind: " << (this->bytes >> 20) << " MB written, " << this->syncs << " syncs, " << this->stalls << " stalls" << std::endl;
+}
+
+/**
+ * @brief Stdio flushed its buffer, queue data for writer thread
+ * @param cookie handle of upload
+ * @param data buffered data
+ * @param size size of data
+ * @return size or -1 if previous write failed
+ */
+ssize_t TFTPWriter::write(void * cookie, const char * data, std::size_t size)
+{
+	TFTPWriter & writer = TFTPWriter::instance();
+	handle & upload = *(handle *) cookie;
+	std::lock_guard<std::mutex> guard(writer.lock);
+
+	if(upload->error != 0)
+	{
+		errno = upload->error;
+		return -1;
+	}
+
+	// disk is slower than network, session stops acknowledging until backlog drains (wait)
+	upload->chunks.emplace_back(data, data + size);
+	upload->pending += size;
+	writer.enqueue(upload);
+
+	return size;
+}
+
+/**
+ * @brief Session closed file, writer closes descriptor after the last chunk
+ * @param cookie handle of upload
+ * @return 0
+ */
+int TFTPWriter::close(void * cookie)
+{
+	TFTPWriter & writer = TFTPWriter::instance();
+	handle * upload = (handle *) cookie;
+
+	writer.lock.lock();
+	(*upload)->closed = true;
+	writer.enqueue(*upload);
+	writer.lock.unlock();
+
+	delete upload;
+
+	return 0;
+}
+
+/**
+ * @brief Wake writer for upload, called with lock held
+ * @param upload upload with new work
+ */
+void TFTPWriter::enqueue(const handle & upload)
+{
+	if(!upload->queued)
+	{
+		upload->queued = true;
+		this->queue.push_back(upload);
+		this->ready.notify_one();
+	}
+}
+
+/**
+ * @brief Writer thread, writes queued chunks until stopped
+ */
+void TFTPWriter::run()
+{
+	std::unique_lock<std::mutex> guard(this->lock);
+	std::deque<std::vector<char>> chunks;
+	std::size_t taken;
+	handle upload;
+
+	while(true)
+	{
+		this->ready.wait(guard, [this]{ return this->stopping || !this->queue.empty(); });
+
+		if(this->queue.empty())
+		{
+			break; // stopping and nothing left
+		}
+
+		upload = this->queue.front();
+		this->queue.pop_front();
+		upload->queued = false;
+		chunks.swap(upload->chunks);
+		taken = upload->pending;
+
+		guard.unlock();
+		this->store(*upload, chunks);
+		guard.lock();
+
+		upload->pending -= taken;
+
+		if(upload->closed && !upload->queued)
+		{
+			guard.unlock();
+			this->complete(*upload);
+			guard.lock();
+		}
+
+		this->notify(*upload);
+
+		upload.reset();
+	}
+}
+
+/**
+ * @brief Hand waiting session back to its loop, lock must be held
+ * @param upload upload which made progress
+ */
+void TFTPWriter::notify(stream & upload)
+{
+	if(upload.waiter == nullptr)
+	{
+		return;
+	}
+
+	upload.loop->resume(upload.waiter);
+	upload.loop = nullptr;
+	upload.waiter = nullptr;
+}
+
+/**
+ * @brief Write chunks to file, failed write drops the rest
+ * @param upload upload
+ * @param chunks chunks taken from upload, emptied
+ */
+void TFTPWriter::store(stream & upload, std::deque<std::vector<char>> & chunks)
+{
+	std::size_t offset;
+	ssize_t result;
+
+	for(std::vector<char> & chunk : chunks)
+	{
+		for(offset = 0; offset < chunk.size() && upload.error == 0; offset += result)
+		{
+			result = ::write(upload.fd, chunk.data() + offset, chunk.size() - offset);
+
+			if(result < 0)
+			{
+				if(errno == EINTR)
+				{
+					result = 0;
+					continue;
+				}
+
+				upload.error = errno;
+				break;
+			}
+
+			upload.written += result;
+			this->bytes += result;
+		}
+
+		if(this->policy == PERIODIC && upload.error == 0 && upload.written - upload.synced >= SYNC_BYTES)
+		{
+			fdatasync(upload.fd);
+			upload.synced = upload.written;
+			++this->syncs;
+		}
+	}
+
+	chunks.clear();
+}
+
+/**
+ * @brief Whole file is written, sync it by policy, release unused reservation and close it
+ * @param upload upload
+ */
+void TFTPWriter::complete(stream & upload)
+{
+	if(upload.error == 0 && this->policy != NONE)
+	{
+		if(fdatasync(upload.fd) != 0)
+		{
+			upload.error = errno;
+		}
+
+		++this->syncs;
+	}
+
+	if(upload.reserved > upload.written)
+	{
+		if(ftruncate(upload.fd, upload.written) != 0)
+		{
+			// blocks stay allocated
+		}
+	}
+
+	::close(upload.fd);
+	upload.done = true;
+}
@@ -0,0 +1,86 @@
+#ifndef H_TFTPWRITER
+#define H_TFTPWRITER
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+
+class TFTPClient;
+class TFTPEventLoop;
+
+class TFTPWriter
+{
+	public:
+		static const std::string NONE; // data left in page cache
+		static const std::string END; // fdatasync before last block is acknowledged
+		static const std::string PERIODIC; // fdatasync every SYNC_BYTES and at the end
+
+		static const std::size_t CHUNK; // stdio buffer of upload, size of single queued write
+		static const std::size_t MAX_PENDING; // queued bytes of upload until session defers its ACK
+		static const long long SYNC_BYTES;
+
+		// uploaded file shared by session and writer thread
+		struct stream
+		{
+			int fd;
+			long long reserved = 0; // preallocated by fallocate
+			long long written = 0;
+			long long synced = 0;
+			std::size_t pending = 0; // bytes in chunks
+			std::vector<char> buffer; // stdio buffer
+			std::deque<std::vector<char>> chunks; // guarded by writer lock
+			bool queued = false; // waits in writer queue
+			bool closed = false; // session closed file, no more chunks
+			TFTPEventLoop * loop = nullptr; // loop of session waiting for writer
+			TFTPClient * waiter = nullptr; // resumed by loop after next write or completion
+			std::atomic<bool> done; // written, synced and closed
+			std::atomic<int> error; // errno of failed write
+
+			stream() : done(false), error(0) {}
+		};
+
+		using handle = std::shared_ptr<stream>;
+
+	private:
+		std::mutex lock;
+		std::condition_variable ready;
+		std::deque<handle> queue;
+		std::thread * thread = nullptr;
+		bool stopping = false;
+		std::string policy;
+
+		std::atomic<unsigned long long> bytes;
+		std::atomic<unsigned long> syncs;
+		std::atomic<unsigned long> stalls;
+
+		TFTPWriter();
+		static ssize_t write(void * cookie, const char * data, std::size_t size);
+		static int close(void * cookie);
+		void enqueue(const handle & upload);
+		void run();
+		void store(stream & upload, std::deque<std::vector<char>> & chunks);
+		void complete(stream & upload);
+		void notify(stream & upload);
+
+	public:
+		static TFTPWriter & instance();
+
+		void start(const std::string & policy);
+		void stop();
+		std::FILE * open(const std::string & path, long long size, handle & upload);
+		bool wait(const handle & upload, TFTPEventLoop * loop, TFTPClient * waiter);
+		void forget(const handle & upload);
+		void print();
+};
+
+#endif